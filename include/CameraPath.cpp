@@ -0,0 +1,105 @@
+#include "CameraPath.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+glm::vec3 CameraKey::front() const
+{
+  const float y = glm::radians(yaw), p = glm::radians(pitch);
+  return glm::normalize(glm::vec3(cos(y) * cos(p), sin(p), sin(y) * cos(p)));
+}
+
+bool CameraPath::load(const std::string &path, std::string &error)
+{
+  std::ifstream in(path);
+  if (!in)
+  {
+    error = "can't open " + path;
+    return false;
+  }
+  keys.clear();
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(in, line))
+  {
+    lineNumber++;
+    const size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#')
+    {
+      continue;
+    }
+    std::istringstream fields(line);
+    CameraKey key;
+    if (!(fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch))
+    {
+      error = path + ":" + std::to_string(lineNumber) + ": expected time x y z yaw pitch";
+      return false;
+    }
+    if (!keys.empty() && key.time < keys.back().time)
+    {
+      error = path + ":" + std::to_string(lineNumber) + ": keys go back in time";
+      return false;
+    }
+    keys.push_back(key);
+  }
+  if (keys.empty())
+  {
+    error = path + " has no keys";
+    return false;
+  }
+  return true;
+}
+
+bool CameraPath::save(const std::string &path) const
+{
+  std::ofstream out(path);
+  if (!out)
+  {
+    return false;
+  }
+  out << "# seconds  x y z  yaw pitch\n";
+  out << std::fixed << std::setprecision(3);
+  for (const CameraKey &key : keys)
+  {
+    out << key.time << "  " << key.position.x << ' ' << key.position.y << ' ' << key.position.z << "  "
+        << key.yaw << ' ' << key.pitch << '\n';
+  }
+  return bool(out);
+}
+
+void CameraPath::add(const CameraKey &key)
+{
+  if (keys.empty() || key.time >= keys.back().time)
+  {
+    keys.push_back(key);
+  }
+}
+
+CameraKey CameraPath::sample(double time) const
+{
+  if (keys.empty())
+  {
+    return CameraKey{};
+  }
+  if (time <= keys.front().time)
+  {
+    return keys.front();
+  }
+  if (time >= keys.back().time)
+  {
+    return keys.back();
+  }
+  // first key after time, the one before it is where we are coming from
+  auto next = std::upper_bound(keys.begin(), keys.end(), time, [](double t, const CameraKey &key)
+                               { return t < key.time; });
+  const CameraKey &b = *next, &a = *(next - 1);
+  const float t = b.time > a.time ? float((time - a.time) / (b.time - a.time)) : 1.0f;
+
+  CameraKey key;
+  key.time = time;
+  key.position = glm::mix(a.position, b.position, t);
+  key.yaw = glm::mix(a.yaw, b.yaw, t);
+  key.pitch = glm::mix(a.pitch, b.pitch, t);
+  return key;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <libs/glm/glm.hpp>
+
+/*
+    A camera flight over time, for replaying the same streaming workload run
+    after run. Stored as text, one key per line:
+
+        # seconds  x y z  yaw pitch (degrees, as in camera.h)
+        0    80 90 80    -90 -20
+        10   400 90 80   0 -20
+
+    Blank lines and lines starting with # are skipped, keys must be in time
+    order. Between keys the position and angles are interpolated linearly,
+    before the first and after the last key the camera holds still. Paths
+    can be written by hand or recorded from main (R starts and stops).
+*/
+struct CameraKey
+{
+    double time = 0.0;
+    glm::vec3 position{0.0f};
+    float yaw = -90.0f;
+    float pitch = 0.0f;
+
+    // unit view direction, the same convention as Camera::Front
+    glm::vec3 front() const;
+};
+
+class CameraPath
+{
+    public:
+    // false (and error filled in) if the file can't be read or a line doesn't parse
+    bool load(const std::string& path, std::string& error);
+    bool save(const std::string& path) const;
+
+    // keys added out of time order are dropped
+    void add(const CameraKey& key);
+    void clear() { keys.clear(); }
+
+    bool empty() const { return keys.empty(); }
+    size_t size() const { return keys.size(); }
+    double duration() const { return keys.empty() ? 0.0 : keys.back().time; }
+
+    CameraKey sample(double time) const;
+
+    private:
+    std::vector<CameraKey> keys;
+};
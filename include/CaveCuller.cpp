@@ -0,0 +1,96 @@
+#include "CaveCuller.hpp"
+
+#include <cmath>
+#include "Chunk.hpp"
+#include "FrustumCuller.hpp"
+#include "SectionVisibility.hpp"
+#include "VoxelTypes.hpp"
+#include "WorldConfig.hpp"
+
+bool CaveCuller::search(const glm::vec3 &cameraPos, const std::vector<glm::vec4> &frustumPlanes,
+                        const std::function<Chunk *(int, int)> &chunkAt)
+{
+  constexpr int W = WorldSettings::CHUNK_WIDTH;
+  constexpr int D = WorldSettings::CHUNK_DEPTH;
+  constexpr int H = WorldSettings::SECTION_HEIGHT;
+
+  int camSection = int(std::floor(cameraPos.y / H));
+  if (camSection < 0 || camSection >= WorldSettings::SECTION_COUNT)
+  {
+    // above or below the world there is no section to start from
+    return false;
+  }
+  Chunk *start = chunkAt(int(std::floor(cameraPos.x / W)), int(std::floor(cameraPos.z / D)));
+  if (start == nullptr)
+  {
+    return false;
+  }
+
+  frame++;
+  queue.clear();
+  auto visit = [&](Chunk *chunk, int section, int enteredFace, uint8_t travelled)
+  {
+    if (chunk->caveFrame != frame)
+    {
+      chunk->caveFrame = frame;
+      chunk->caveVisited = 0;
+    }
+    if (chunk->caveVisited & (1u << section))
+    {
+      return;
+    }
+    chunk->caveVisited |= uint16_t(1u << section);
+    queue.push_back(Step{chunk, section, enteredFace, travelled});
+  };
+
+  visit(start, camSection, -1, 0);
+  for (size_t head = 0; head < queue.size(); ++head)
+  {
+    const Step step = queue[head];
+    const uint16_t connectivity = step.chunk->getSectionVisibility()[step.section];
+    for (int face = 0; face < 6; ++face)
+    {
+      const int back = SectionVisibility::opposite(face);
+      // never head back against a direction we already moved in, that is what keeps
+      // the search from leaking around corners the camera cannot see past
+      if (step.travelled & (1u << back))
+      {
+        continue;
+      }
+      // we can only leave through this face if it is open to the one we came in by
+      if (step.enteredFace >= 0 && !SectionVisibility::connected(connectivity, step.enteredFace, face))
+      {
+        continue;
+      }
+
+      const glm::ivec3 offset = dirOffsets[face];
+      const int nextSection = step.section + offset.y;
+      if (nextSection < 0 || nextSection >= WorldSettings::SECTION_COUNT)
+      {
+        continue;
+      }
+      Chunk *next = step.chunk;
+      if (offset.x != 0 || offset.z != 0)
+      {
+        next = chunkAt(step.chunk->chunkX + offset.x, step.chunk->chunkZ + offset.z);
+        if (next == nullptr)
+        {
+          continue;
+        }
+      }
+
+      const glm::vec3 sectionMin(next->chunkX * W, nextSection * H, next->chunkZ * D);
+      if (!FrustumCuller::isBoxVisible(frustumPlanes, AABB{sectionMin, sectionMin + glm::vec3(W, H, D)}))
+      {
+        continue;
+      }
+      visit(next, nextSection, back, uint8_t(step.travelled | (1u << face)));
+    }
+  }
+  return true;
+}
+
+bool CaveCuller::reached(const Chunk &chunk) const
+{
+  return chunk.caveFrame == frame && chunk.caveVisited != 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <libs/glm/glm.hpp>
+
+class Chunk;
+
+/*
+    Breadth-first search from the camera's section through the sections'
+    face-to-face connectivity (see SectionVisibility.hpp). A chunk the
+    search never reaches is walled off from the camera by solid rock, so it
+    can be dropped even when it sits in the frustum.
+
+    Marks go straight on the chunks (Chunk::caveFrame / caveVisited) so the
+    search needs no set of its own, which also means only one culler should
+    walk a given set of chunks.
+
+        cave.search(cameraPos, frustumPlanes, [&](int cx, int cz) { return access.chunkAt(cx, cz); });
+        if (cave.reached(*chunk)) ...
+*/
+class CaveCuller
+{
+    public:
+    // chunkAt returns nullptr for chunks that aren't loaded, the search stops there. returns false
+    // when the camera is above or below the world or its chunk isn't loaded, nothing was marked then
+    bool search(const glm::vec3& cameraPos, const std::vector<glm::vec4>& frustumPlanes,
+                const std::function<Chunk*(int, int)>& chunkAt);
+
+    // whether any section of the chunk was reached by the last search
+    bool reached(const Chunk& chunk) const;
+
+    private:
+    struct Step
+    {
+        Chunk *chunk;
+        int section;
+        int enteredFace; // -1 for the camera's own section
+        uint8_t travelled; // bit per direction already moved in
+    };
+    // reused every frame
+    std::vector<Step> queue;
+    uint32_t frame = 0;
+};
@@ -1,52 +1,93 @@
 #include "Chunk.hpp"
+#include <algorithm>
 #include <array>
 #include <vector>
 #include <memory>
 #include "Mesh.hpp"          
 #include "VoxelTypes.hpp" 
 #include "World.hpp"  
+#include "WorldAccessor.hpp"
 #include "WorldConfig.hpp"
 #include "FastNoiseLite.h"
+#include "SectionVisibility.hpp"
+#include "Log.hpp"
+#include "Trace.hpp"
 
  
 
-    Chunk::Chunk(int chunkX, int chunkZ, World& worldptr, FastNoiseLite& noiseptr) : chunkX(chunkX), chunkZ(chunkZ), dirty(true), scheduled(false), hasBeenGenerated(false),
+    Chunk::Chunk(int chunkX, int chunkZ, World& worldptr, FastNoiseLite& noiseptr) : Chunk(chunkX, chunkZ, noiseptr)
+    {
+      world = &worldptr;
+    }
+
+    Chunk::Chunk(int chunkX, int chunkZ, FastNoiseLite& noiseptr) : chunkX(chunkX), chunkZ(chunkZ), scheduled(false), hasBeenGenerated(false),
         box{
             glm::vec3(chunkX * float(WorldSettings::CHUNK_WIDTH), 0.0f, chunkZ * float(WorldSettings::CHUNK_DEPTH)), 
             glm::vec3(chunkX * float(WorldSettings::CHUNK_WIDTH) + float(WorldSettings::CHUNK_WIDTH), 
             float(WorldSettings::CHUNK_HEIGHT), chunkZ * float(WorldSettings::CHUNK_DEPTH) + float(WorldSettings::CHUNK_DEPTH))
-        }, world(worldptr), noise(noiseptr)
+        }, noise(noiseptr)
     {
       // initialize everything to Air
-      blocks.fill(BlockType::Air);
+      for (std::atomic<BlockType>& block : blocks) block.store(BlockType::Air, std::memory_order_relaxed);
+      meshSectionBounds.fill(SectionBounds{float(WorldSettings::CHUNK_HEIGHT), 0.0f});
+      sectionBounds = meshSectionBounds;
+      // until we have meshed, assume light gets through everywhere
+      meshSectionVisibility.fill(SectionVisibility::ALL_CONNECTED);
+      sectionVisibility = meshSectionVisibility;
     }
 
-    // set a block and mark dirty so we regenerate the mesh next frame
+    // no bookkeeping here, World::setBlock marks the sections that need a remesh
     void Chunk::setBlock(int x, int y, int z, BlockType type) {
-      blocks[index(x,y,z)] = type;
+      std::atomic<BlockType>& slot = blocks[index(x,y,z)];
+      std::atomic<uint16_t>& count = solidCounts[y / WorldSettings::SECTION_HEIGHT];
+      const BlockType old = slot.load(std::memory_order_relaxed);
+      // one writer per chunk, so no read-modify-write is needed
+      count.store(uint16_t(count.load(std::memory_order_relaxed) + int(type != BlockType::Air) - int(old != BlockType::Air)),
+                  std::memory_order_relaxed);
+      slot.store(type, std::memory_order_relaxed);
     }
 
-    // read without marking dirty
+    // read without marking anything
     BlockType Chunk::getBlock(int x, int y, int z) const {
-      return blocks[index(x,y,z)];
+      return blocks[index(x,y,z)].load(std::memory_order_relaxed);
+    }
+
+    void Chunk::setupNoise(FastNoiseLite& noise, int seed)
+    {
+        noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2S);
+        noise.SetSeed(seed);
+        noise.SetFractalType(FastNoiseLite::FractalType_FBm);
+        noise.SetFrequency(0.01);
+        noise.SetFractalOctaves(9);
+        noise.SetFractalLacunarity(1.5);
+        noise.SetFractalGain(0.02);
+        noise.SetFrequency(0.007);
+        noise.SetDomainWarpType(FastNoiseLite::DomainWarpType_OpenSimplex2);
+        noise.SetDomainWarpAmp(50.0);
+    }
+
+    int Chunk::surfaceHeight(const FastNoiseLite& noise, int worldX, int worldZ)
+    {
+        float xW = noise.GetNoise((float)worldX, (float)worldZ) * 10;
+        float zW = noise.GetNoise((float)worldZ, (float)worldX) * 10;
+
+        // double height = noise.getWorldNoise(worldX, worldZ);
+        // int surfaceY = static_cast<int>( height * WorldSettings::MAX_SURFACE);
+        float height = abs(noise.GetNoise((float)xW, (float)zW)) * WorldSettings::CHUNK_HEIGHT;
+        float clampedH = std::min(height, 200.0f);
+        return static_cast<int>(clampedH);
     }
 
     void Chunk::generate()
     {
+        TRACE_ZONE("generate");
         for (int x = 0; x < WorldSettings::CHUNK_WIDTH; x++)
         {
             for (int z = 0; z < WorldSettings::CHUNK_DEPTH; z++)
             {
                 int worldX = chunkX * WorldSettings::CHUNK_WIDTH + x;
                 int worldZ = chunkZ * WorldSettings::CHUNK_DEPTH + z;
-                float xW = noise.GetNoise((float)worldX, (float)worldZ) * 10;
-                float zW = noise.GetNoise((float)worldZ, (float)worldX) * 10;
-
-                // double height = noise.getWorldNoise(worldX, worldZ);
-                // int surfaceY = static_cast<int>( height * WorldSettings::MAX_SURFACE);
-                float height = abs(noise.GetNoise((float)xW, (float)zW)) * WorldSettings::CHUNK_HEIGHT;
-                float clampedH = std::min(height, 200.0f);
-                int surfaceY = static_cast<int>(clampedH);
+                int surfaceY = surfaceHeight(noise, worldX, worldZ);
                 for (int y = 0; y < WorldSettings::CHUNK_HEIGHT; y++)
                 {
                     if (y == surfaceY) setBlock(x, y, z, BlockType::Grass);
@@ -57,7 +98,8 @@
         }
     }
 
-    void Chunk::addFaceQuad(std::vector<Vertex>& verts, std::vector<uint32_t>& idx, int x, int y, int z, int dir, BlockType type)
+    void Chunk::addFaceQuad(std::vector<Vertex>& verts, std::vector<uint32_t>& idx, int x, int y, int z, int dir, BlockType type, int scale, uint8_t light,
+                            const std::array<uint8_t, 4>& occlusion)
     {
         // populate vectors then they are passed to mesh in the build function
         float atlasWidth = 1024.0f;   // actual pixel width of atlas
@@ -66,7 +108,7 @@
 
         auto atlasOffset = blockTextureOffsets.at(type);
 
-        glm::vec2 textCoord;
+        glm::vec2 textCoord = atlasOffset.sides;
         if (dir == 0 || dir == 1 || dir == 4 || dir == 5) {
             textCoord = atlasOffset.sides;
         } else if (dir == 2) {
@@ -77,15 +119,18 @@
 
         auto baseIndicies = verts.size();
         auto normal = dirOffsets[dir];
+        // x, y, z are cell coordinates, a cell is scale blocks wide on LOD meshes
+        growSectionBounds(y * scale / WorldSettings::SECTION_HEIGHT, float(y * scale), float((y + 1) * scale));
 
         glm::vec2 uvScale = glm::vec2(tileSizePx / atlasWidth, tileSizePx / atlasHeight);
+        const glm::vec2 faceLight = glm::vec2(light >> 4, light & 0x0F) / float(MAX_LIGHT);
 
         // iterate for the 4 points ands add the offsets to the x, y, z to get the coordinates in local
         // space and then add that to the vertex array so when drawn each struct is each triangle
         for (int i = 0; i < 4; i++)
         {
             // this grabs the unique value for the given direction to increment x, y or z
-            glm::ivec3 pos = glm::vec3(x, y, z) + vertexOffsets[dir][i];
+            glm::ivec3 pos = (glm::vec3(x, y, z) + vertexOffsets[dir][i]) * float(scale);
 
             // this takes the scale from the dimensions of the atlas photo and then sets the u0, v0
             glm::vec2 uv = faceUVs[i] * uvScale + textCoord * uvScale;
@@ -93,19 +138,25 @@
             verts.push_back(Vertex{
                 .Position = pos,
                 .Normal = normal,
-                .TexCoords = uv
+                .TexCoords = uv,
+                .Light = faceLight,
+                .Occlusion = occlusion[i] / 3.0f
             });
         }
 
         // the base idx is based on the size of the verts array so that way it servers as the offset at
-        // that given position when you add an array 
-        idx.push_back(baseIndicies + 0);
-        idx.push_back(baseIndicies + 1);
-        idx.push_back(baseIndicies + 2);
-
-        idx.push_back(baseIndicies + 2);
-        idx.push_back(baseIndicies + 3);
-        idx.push_back(baseIndicies + 0);
+        // that given position when you add an array.
+        // the quad is split along the diagonal whose corners are brighter together, otherwise a single
+        // dark corner gets interpolated down the whole diagonal and the shading looks different
+        // depending on which way the face happens to be turned
+        const int first = occlusion[0] + occlusion[2] < occlusion[1] + occlusion[3] ? 1 : 0;
+        idx.push_back(baseIndicies + first);
+        idx.push_back(baseIndicies + first + 1);
+        idx.push_back(baseIndicies + first + 2);
+
+        idx.push_back(baseIndicies + first + 2);
+        idx.push_back(baseIndicies + (first + 3) % 4);
+        idx.push_back(baseIndicies + first);
         
     }
 
@@ -128,6 +179,10 @@
 
         glm::vec2 uvScale = glm::vec2(tileSizePx / atlasWidth, tileSizePx / atlasHeight);
 
+        float lo = std::min(std::min(corners[0].y, corners[1].y), std::min(corners[2].y, corners[3].y));
+        float hi = std::max(std::max(corners[0].y, corners[1].y), std::max(corners[2].y, corners[3].y));
+        growSectionBounds(std::min(int(lo) / WorldSettings::SECTION_HEIGHT, WorldSettings::SECTION_COUNT - 1), lo, hi);
+
         auto baseIndicies = verts.size();
         for (int i = 0; i < 4; i++) {
             glm::vec2 uv = faceUVs[i] * uvScale + textCoord * uvScale;
@@ -227,7 +282,7 @@
                                 origin + dv
                             };
 
-                            std::cout << static_cast<int>(block_t) << std::endl;
+                            LOG_DEBUG("greedy quad of block " << static_cast<int>(block_t));
                             addFaceQuad(verts, idx, corners, dir, block_t);
 
                             for (l = 0; l < h; l++)
@@ -246,50 +301,275 @@
 
     void Chunk::buildMesh() 
     {
+        std::array<const Chunk*, 9> around{};
+        if (world == nullptr)
+        {
+            buildMesh(around, true);
+            return;
+        }
+        // the accessor keeps the neighbours from being freed until we are done with them
+        WorldAccessor access(*world);
+        for (int dz = -1; dz <= 1; dz++)
+        for (int dx = -1; dx <= 1; dx++)
+            if (dx != 0 || dz != 0) around[(dx + 1) + 3 * (dz + 1)] = access.chunkAt(chunkX + dx, chunkZ + dz);
+        buildMesh(around, world->ambientOcclusionEnabled());
+    }
+
+    void Chunk::buildMesh(std::array<const Chunk*, 9> around, bool occlusion)
+    {
+        TRACE_ZONE("mesh");
+        const int level = lod.load();
+        uint16_t sections = dirtySections.exchange(0);
+        meshEditTicks = editTicks.exchange(0);
+        // the first mesh and a change of level touch every section. so does any LOD mesh: a coarse
+        // cell straddles the sections edits are marked by, and the skirts follow the column tops
+        // wherever they change. coarse meshes are cheap enough to redo whole
+        if (level != meshedLod || level != 0) {
+            sections = uint16_t((1u << WorldSettings::SECTION_COUNT) - 1);
+            meshedLod = level;
+        }
+
+        for (int s = 0; s < WorldSettings::SECTION_COUNT; s++)
+        {
+            if (!(sections & (1u << s))) continue;
+            sectionMeshes[s].verts.clear();
+            sectionMeshes[s].idx.clear();
+            meshSectionBounds[s] = SectionBounds{float(WorldSettings::CHUNK_HEIGHT), 0.0f};
+        }
+
+        if (level == 0)
+        {
+            // full resolution: cells are voxels and faces on the border look into the neighbour chunk.
+            // corner shading also looks diagonally, so we need all 3x3 chunks around this one
+            around[4] = this;
+            uint8_t seen = 0;
+            for (int dz = -1; dz <= 1; dz++)
+            for (int dx = -1; dx <= 1; dx++) {
+                const Chunk* c = around[(dx + 1) + 3 * (dz + 1)];
+                if (c != this && c != nullptr && c->generated.load()) seen |= uint8_t(1u << neighbourBit(dx, dz));
+            }
+            meshedNeighbours = seen;
+            auto owner = [&](int x, int z) -> const Chunk* {
+                const int ox = x < 0 ? 0 : x >= WorldSettings::CHUNK_WIDTH ? 2 : 1;
+                const int oz = z < 0 ? 0 : z >= WorldSettings::CHUNK_DEPTH ? 2 : 1;
+                return around[ox + 3 * oz];
+            };
+            auto sample = [&](int x, int y, int z) {
+                const Chunk* c = owner(x, z);
+                if (c == nullptr) return BlockType::NoBlock;
+                return c->blockAt(cellIndex(WorldAccessor::localCoord(x), y, WorldAccessor::localCoord(z)));
+            };
+            auto lightAt = [&](int x, int y, int z) -> uint8_t {
+                const Chunk* c = owner(x, z);
+                return c == nullptr ? uint8_t(MAX_LIGHT << 4) : c->light[cellIndex(WorldAccessor::localCoord(x), y, WorldAccessor::localCoord(z))].load(std::memory_order_relaxed);
+            };
+            for (int s = 0; s < WorldSettings::SECTION_COUNT; s++)
+            {
+                // an all-air section has no faces of its own, its neighbours draw the ones facing it
+                if ((sections & (1u << s)) && sectionBlockCount(s) != 0) meshSection(1, s, occlusion, sample, lightAt);
+            }
+        }
+        else
+        {
+            meshedNeighbours = 0xFF;
+            const int scale = 1 << level;
+            std::vector<BlockType> cells;
+            downsample(scale, cells);
+
+            const int w = WorldSettings::CHUNK_WIDTH / scale;
+            const int h = WorldSettings::CHUNK_HEIGHT / scale;
+            const int d = WorldSettings::CHUNK_DEPTH / scale;
+
+            // top solid cell of every column, -1 for an empty column
+            std::vector<int> tops(size_t(w) * d, -1);
+            for (int z = 0; z < d; z++)
+            for (int x = 0; x < w; x++)
+            for (int y = h - 1; y >= 0; y--)
+                if (cells[x + w * (y + h * z)] != BlockType::Air) { tops[x + w * z] = y; break; }
+
+            // outside the chunk counts as air down to SKIRT_DEPTH below the border column's top,
+            // so the border gets a short wall (a skirt) that hides cracks against a neighbour at
+            // another level. below that it counts as solid so we don't wall off the whole column
+            const int skirtCells = std::max(1, WorldSettings::LOD_SKIRT_DEPTH / scale);
+            auto sample = [&](int x, int y, int z) {
+                if (x >= 0 && x < w && z >= 0 && z < d) return cells[x + w * (y + h * z)];
+                int top = tops[std::clamp(x, 0, w - 1) + w * std::clamp(z, 0, d - 1)];
+                return y > top - skirtCells ? BlockType::Air : BlockType::Stone;
+            };
+            // too far away for light to show, everything is lit as if it were under the open sky
+            auto lightAt = [](int, int, int) { return uint8_t(MAX_LIGHT << 4); };
+            for (int s = 0; s < WorldSettings::SECTION_COUNT; s++)
+            {
+                // a cell here is several blocks wide, corner shading would just smear across it
+                if (sections & (1u << s)) meshSection(scale, s, false, sample, lightAt);
+            }
+        }
+
+        buildOccluders();
+        for (int s = 0; s < WorldSettings::SECTION_COUNT; s++)
+        {
+            if (sections & (1u << s)) buildSectionVisibility(s);
+        }
+
+        // stitch the sections back into one buffer, indices shifted by where each section lands
+        size_t vertCount = 0, idxCount = 0;
+        for (const SectionMesh& section : sectionMeshes) {
+            vertCount += section.verts.size();
+            idxCount += section.idx.size();
+        }
         verts.clear();
         idx.clear();
-        verts.reserve(WorldSettings::CHUNK_SIZE * 24);
-        idx.reserve(WorldSettings::CHUNK_SIZE * 36);
+        // straight into mapped GPU memory when the world has a staging ring with room, the render
+        // thread then only has to issue the copy
+        StagingRing* ring = world ? &world->stagingRing() : nullptr;
+        const size_t vertexBytes = vertCount * sizeof(Vertex);
+        if (ring && ring->allocate(vertexBytes + idxCount * sizeof(uint32_t), staged))
+        {
+            Vertex* outVerts = reinterpret_cast<Vertex*>(staged.data);
+            uint32_t* outIdx = reinterpret_cast<uint32_t*>(staged.data + vertexBytes);
+            uint32_t base = 0;
+            for (const SectionMesh& section : sectionMeshes)
+            {
+                std::copy(section.verts.begin(), section.verts.end(), outVerts + base);
+                for (uint32_t i : section.idx) *outIdx++ = base + i;
+                base += uint32_t(section.verts.size());
+            }
+            stagedVertices = uint32_t(vertCount);
+            stagedIndices = uint32_t(idxCount);
+            return;
+        }
+        verts.reserve(vertCount);
+        idx.reserve(idxCount);
+        for (const SectionMesh& section : sectionMeshes)
+        {
+            const uint32_t base = uint32_t(verts.size());
+            verts.insert(verts.end(), section.verts.begin(), section.verts.end());
+            for (uint32_t i : section.idx) idx.push_back(base + i);
+        }
+    }
 
-        for (int x = 0; x < WorldSettings::CHUNK_WIDTH; x++)
+    void Chunk::buildSectionVisibility(int section)
+    {
+        constexpr int W = WorldSettings::CHUNK_WIDTH;
+        constexpr int S = WorldSettings::SECTION_HEIGHT;
+        constexpr int D = WorldSettings::CHUNK_DEPTH;
+        constexpr int cells = W * S * D;
+        const int baseY = section * S;
+        auto isOpen = [&](int x, int ly, int z) { return getBlock(x, baseY + ly, z) == BlockType::Air; };
+
+        // most sections are entirely solid or entirely air, skip the fill for those
+        const int open = cells - sectionBlockCount(section);
+        if (open == 0) {
+            meshSectionVisibility[section] = SectionVisibility::NONE_CONNECTED;
+            return;
+        }
+        if (open == cells) {
+            meshSectionVisibility[section] = SectionVisibility::ALL_CONNECTED;
+            return;
+        }
+
+        // flood each pocket of air and connect every face it touches
+        std::array<bool, cells> seen{};
+        std::vector<int> stack;
+        stack.reserve(cells);
+        uint16_t set = SectionVisibility::NONE_CONNECTED;
+        for (int start = 0; start < cells; start++)
         {
-            for (int z = 0; z < WorldSettings::CHUNK_DEPTH; z++)
+            int sx = start % W, sy = (start / W) % S, sz = start / (W * S);
+            if (seen[start] || !isOpen(sx, sy, sz)) continue;
+
+            uint8_t faces = 0;
+            seen[start] = true;
+            stack.push_back(start);
+            while (!stack.empty())
             {
-                for (int y = 0; y < WorldSettings::CHUNK_HEIGHT; y++)
+                int c = stack.back();
+                stack.pop_back();
+                int x = c % W, ly = (c / W) % S, z = c / (W * S);
+
+                // same face order as dirOffsets: +Z, -Z, +Y, -Y, +X, -X
+                if (z == D - 1) faces |= 1u << 0;
+                if (z == 0)     faces |= 1u << 1;
+                if (ly == S - 1) faces |= 1u << 2;
+                if (ly == 0)     faces |= 1u << 3;
+                if (x == W - 1) faces |= 1u << 4;
+                if (x == 0)     faces |= 1u << 5;
+
+                for (int d = 0; d < 6; d++)
                 {
-                    if (getBlock(x, y, z) == BlockType::Air) continue;
+                    int nx = x + int(dirOffsets[d].x), ny = ly + int(dirOffsets[d].y), nz = z + int(dirOffsets[d].z);
+                    if (nx < 0 || nx >= W || ny < 0 || ny >= S || nz < 0 || nz >= D) continue;
+                    int n = nx + W * (ny + S * nz);
+                    if (seen[n] || !isOpen(nx, ny, nz)) continue;
+                    seen[n] = true;
+                    stack.push_back(n);
+                }
+            }
+            set = SectionVisibility::connectAll(set, faces);
+            if (set == SectionVisibility::ALL_CONNECTED) break;
+        }
+        meshSectionVisibility[section] = set;
+    }
+
+    template <class Sample, class LightAt>
+    void Chunk::meshSection(int scale, int section, bool occlusion, Sample&& sample, LightAt&& lightAt)
+    {
+        const int w = WorldSettings::CHUNK_WIDTH / scale;
+        const int h = WorldSettings::CHUNK_HEIGHT / scale;
+        const int d = WorldSettings::CHUNK_DEPTH / scale;
+        const int cellsPerSection = WorldSettings::SECTION_HEIGHT / scale;
+        const int sectionY = section * cellsPerSection;
+        std::vector<Vertex>& out = sectionMeshes[section].verts;
+        std::vector<uint32_t>& outIdx = sectionMeshes[section].idx;
+
+        for (int x = 0; x < w; x++)
+        {
+            for (int z = 0; z < d; z++)
+            {
+                for (int y = sectionY; y < sectionY + cellsPerSection; y++)
+                {
+                    BlockType type = sample(x, y, z);
+                    if (type == BlockType::Air) continue;
 
-                    BlockType type = getBlock(x, y, z);
                     // this is now a struct of top , sides , bottom
-                    for (int d = 0; d < 6; d++)
+                    for (int dir = 0; dir < 6; dir++)
                     {
                         // loop through the 6 faces and use a direction offset array to store to values
-                        glm::ivec3 offsets = dirOffsets[d];
+                        glm::ivec3 offsets = dirOffsets[dir];
                         int tx = x + offsets.x;
                         int ty = y + offsets.y;
                         int tz = z + offsets.z;
 
-
-                        int chunkOffsetX = 0;
-                        if (tx <  0) chunkOffsetX = -1;
-                        if (tx >= WorldSettings::CHUNK_WIDTH) chunkOffsetX = +1;
-
-                        int chunkOffsetZ = 0;
-                        if (tz <  0) chunkOffsetZ = -1;
-                        if (tz >= WorldSettings::CHUNK_WIDTH) chunkOffsetZ = +1;
-
-                        if (chunkOffsetX == 0 && chunkOffsetZ == 0) {
-                            if (getBlock(tx, ty, tz) == BlockType::Air) {
-                                addFaceQuad(verts, idx, x, y, z, d, type);
-                            }
-                        } else {
-                            int nChunkX = chunkX + chunkOffsetX;
-                            int nChunkZ = chunkZ + chunkOffsetZ;
-
-                            BlockType block_t = world.getChunk(nChunkX, nChunkZ, tx, y, tz);
-                            if (block_t == BlockType::Air) {
-                                addFaceQuad(verts, idx, x, y, z, d, type);
+                        // nothing can look at the underside of the world, the sky is open
+                        if (ty < 0) continue;
+                        BlockType neighbour = ty >= h ? BlockType::Air : sample(tx, ty, tz);
+                        if (neighbour == BlockType::Air) {
+                            // above the top of the world is open sky
+                            uint8_t light = ty >= h ? uint8_t(MAX_LIGHT << 4) : lightAt(tx, ty, tz);
+                            std::array<uint8_t, 4> corners = {3, 3, 3, 3};
+                            if (occlusion && ty < h) {
+                                // the ring of cells around the one the face looks into, in the plane of the
+                                // face. a corner loses a step for each solid cell among its two sides and the
+                                // diagonal between them, and goes fully dark when both sides are solid
+                                const int n = dir < 2 ? 2 : dir < 4 ? 1 : 0;
+                                const int u = (n + 1) % 3, v = (n + 2) % 3;
+                                bool solid[3][3] = {};
+                                for (int du = -1; du <= 1; du++)
+                                for (int dv = -1; dv <= 1; dv++) {
+                                    if (du == 0 && dv == 0) continue;
+                                    glm::ivec3 p(tx, ty, tz);
+                                    p[u] += du;
+                                    p[v] += dv;
+                                    solid[du + 1][dv + 1] = p.y >= 0 && p.y < h && blocksLight(sample(p.x, p.y, p.z));
+                                }
+                                for (int i = 0; i < 4; i++) {
+                                    const int cu = vertexOffsets[dir][i][u] > 0.5f ? 2 : 0;
+                                    const int cv = vertexOffsets[dir][i][v] > 0.5f ? 2 : 0;
+                                    const int side1 = solid[cu][1], side2 = solid[1][cv], corner = solid[cu][cv];
+                                    corners[i] = uint8_t(side1 && side2 ? 0 : 3 - side1 - side2 - corner);
+                                }
                             }
+                            addFaceQuad(out, outIdx, x, y, z, dir, type, scale, light, corners);
                         }
                     }
                 }
@@ -297,41 +577,125 @@
         }
     }
 
-    void Chunk::setData()
+    void Chunk::downsample(int scale, std::vector<BlockType>& cells) const
     {
-        mesh.setData(verts, idx);
+        const int w = WorldSettings::CHUNK_WIDTH / scale;
+        const int h = WorldSettings::CHUNK_HEIGHT / scale;
+        const int d = WorldSettings::CHUNK_DEPTH / scale;
+        cells.assign(size_t(w) * h * d, BlockType::Air);
+
+        for (int cz = 0; cz < d; cz++)
+        for (int cy = 0; cy < h; cy++)
+        for (int cx = 0; cx < w; cx++)
+        {
+            // the most common block in the scale^3 cell wins, solid wins a tie with air
+            std::array<int, BLOCK_TYPE_COUNT> counts{};
+            for (int z = cz * scale; z < (cz + 1) * scale; z++)
+            for (int y = cy * scale; y < (cy + 1) * scale; y++)
+            for (int x = cx * scale; x < (cx + 1) * scale; x++)
+                counts[uint8_t(getBlock(x, y, z))]++;
+
+            BlockType best = BlockType::Air;
+            int bestCount = counts[uint8_t(BlockType::Air)];
+            for (int t = 0; t < BLOCK_TYPE_COUNT; t++) {
+                if (t == int(BlockType::Air) || counts[t] < bestCount || counts[t] == 0) continue;
+                best = BlockType(t);
+                bestCount = counts[t];
+            }
+            cells[cx + w * (cy + h * cz)] = best;
+        }
     }
 
-    bool Chunk::IsAabbVisible(const std::vector<glm::vec4>& frustumPlanes) {
-
-        const glm::vec3& vmin = this->box.vmin;
-        const glm::vec3& vmax = this->box.vmax;
-
-        for (size_t i = 0; i < frustumPlanes.size(); ++i) {
-            const glm::vec4& g = frustumPlanes[i];
-            if ((glm::dot(g, glm::vec4(vmin.x, vmin.y, vmin.z, 1.0f)) < 0.0) &&
-             (glm::dot(g, glm::vec4(vmax.x, vmin.y, vmin.z, 1.0f)) < 0.0) &&
-             (glm::dot(g, glm::vec4(vmin.x, vmax.y, vmin.z, 1.0f)) < 0.0) &&
-             (glm::dot(g, glm::vec4(vmax.x, vmax.y, vmin.z, 1.0f)) < 0.0) &&
-             (glm::dot(g, glm::vec4(vmin.x, vmin.y, vmax.z, 1.0f)) < 0.0) &&
-             (glm::dot(g, glm::vec4(vmax.x, vmin.y, vmax.z, 1.0f)) < 0.0) &&
-             (glm::dot(g, glm::vec4(vmin.x, vmax.y, vmax.z, 1.0f)) < 0.0) &&
-             (glm::dot(g, glm::vec4(vmax.x, vmax.y, vmax.z, 1.0f)) < 0.0))
+    void Chunk::buildOccluders()
+    {
+        // a cell only occludes up to its lowest column, so holes and overhangs just lower it
+        constexpr int cellsX = WorldSettings::CHUNK_WIDTH / WorldSettings::OCCLUDER_CELL;
+        meshOccluderHeights.fill(uint16_t(WorldSettings::CHUNK_HEIGHT));
+        for (int x = 0; x < WorldSettings::CHUNK_WIDTH; x++)
+        {
+            for (int z = 0; z < WorldSettings::CHUNK_DEPTH; z++)
             {
-             // Not visible - all returned negative
-             return false;
+                int y = 0;
+                while (y < WorldSettings::CHUNK_HEIGHT && getBlock(x, y, z) != BlockType::Air) y++;
+
+                uint16_t& cell = meshOccluderHeights[(z / WorldSettings::OCCLUDER_CELL) * cellsX + x / WorldSettings::OCCLUDER_CELL];
+                cell = std::min(cell, uint16_t(y));
             }
         }
+    }
 
-        // Potentially visible
-        return true;
+    void Chunk::growSectionBounds(int section, float lo, float hi)
+    {
+        SectionBounds& b = meshSectionBounds[section];
+        b.minY = std::min(b.minY, lo);
+        b.maxY = std::max(b.maxY, hi);
     }
- 
+
+    size_t Chunk::meshBytes() const
+    {
+        if (staged.data) return staged.bytes;
+        return verts.size() * sizeof(Vertex) + idx.size() * sizeof(uint32_t);
+    }
+
+    void Chunk::setData()
+    {
+        uploadMesh(Mesh::Slot::Live);
+        takeMeshInfo();
+    }
+
+    void Chunk::uploadMesh(Mesh::Slot slot)
+    {
+        if (staged.data)
+        {
+            StagingRing& ring = world->stagingRing();
+            mesh.copyFrom(ring.buffer(), staged.offset, stagedVertices, stagedIndices, slot);
+            ring.release(staged);
+            staged = StagingRing::Allocation{};
+        }
+        else
+        {
+            mesh.setData(verts, idx, slot);
+        }
+    }
+
+    void Chunk::publishMesh()
+    {
+        mesh.publish();
+        takeMeshInfo();
+    }
+
+    void Chunk::takeMeshInfo()
+    {
+        // shrink the box to the sections that actually produced geometry
+        sectionBounds = meshSectionBounds;
+        occluderHeights = meshOccluderHeights;
+        sectionVisibility = meshSectionVisibility;
+        float minY = float(WorldSettings::CHUNK_HEIGHT), maxY = 0.0f;
+        for (const SectionBounds& b : sectionBounds) {
+            if (b.empty()) continue;
+            minY = std::min(minY, b.minY);
+            maxY = std::max(maxY, b.maxY);
+        }
+        if (minY <= maxY) {
+            box.vmin.y = minY;
+            box.vmax.y = maxY;
+        }
+    }
+
+    void Chunk::discardMesh()
+    {
+        if (staged.data)
+        {
+            world->stagingRing().release(staged);
+            staged = StagingRing::Allocation{};
+        }
+    }
+
     // just draws the mesh (one glDrawElements call under the hood)
-    void Chunk::draw(Shader& shader, GLuint& atlasText) {
+    void Chunk::draw(Shader& shader) {
         glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(chunkX * WorldSettings::CHUNK_WIDTH, 0.0f, chunkZ * WorldSettings::CHUNK_DEPTH));
         shader.setMat4("model", model);
-        mesh.draw(shader, atlasText);
+        mesh.draw();
     }
 
     std::vector<glm::vec3> Chunk::GetAABBVertices(const AABB& box) {
@@ -1,12 +1,15 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <vector>
 #include "shader_m.h"
 #include "VoxelTypes.hpp"
 #include "Mesh.hpp"   
+#include "StagingRing.hpp"
 #include "WorldConfig.hpp"
 #include "FastNoiseLite.h"
+#include "SafeQueue.hpp"
 
 
 class World;
@@ -15,37 +18,165 @@ class Chunk
 {
     public:
     Chunk(int chunkX, int chunkZ, World& world, FastNoiseLite& noiseptr);
+    // a chunk outside any world, for tools like the headless bench. buildMesh() sees no neighbours,
+    // the caller hands them to buildMesh(around, occlusion) instead
+    Chunk(int chunkX, int chunkZ, FastNoiseLite& noiseptr);
 
     int chunkX;
     int chunkZ;
 
-    std::atomic<bool> dirty;
+    // bit per section still waiting for a remesh, set by the render thread and taken by the worker
+    std::atomic<uint16_t> dirtySections{0};
     std::atomic<bool> scheduled;
     std::atomic<bool> hasBeenGenerated;
+    // true once generate() has run, edits before that would be overwritten
+    std::atomic<bool> generated{false};
+    // steady clock ns of the oldest edit no mesh has picked up yet, 0 for none
+    std::atomic<int64_t> editTicks{0};
+    // set by the render thread when the chunk leaves the loaded square
+    bool unloaded = false;
+    // World::chunkEpoch right after the unload (render thread only)
+    uint64_t retiredEpoch = 0;
+    // waiting in the world's prefetch cache instead of the loaded map (render thread only)
+    bool prefetched = false;
+    // the job in flight brings back no mesh to upload (render thread only)
+    bool generateOnly = false;
+    // a prefetch dropped before a worker got to it, the worker skips the generation
+    std::atomic<bool> prefetchCancelled{false};
+    // level of detail the next mesh uses, cells are 2^lod blocks wide
+    std::atomic<int> lod{0};
+    // which of the 8 chunks around this one (see neighbourBit) were generated when the last full
+    // resolution mesh looked at them. border faces and their corner shading are only right for those.
+    // all set for LOD meshes, they never look outside the chunk
+    std::atomic<uint8_t> meshedNeighbours{0};
+    static int neighbourBit(int dx, int dz)
+    {
+        const int i = (dx + 1) + 3 * (dz + 1);
+        return i < 4 ? i : i - 1;
+    }
 
-    std::array<BlockType, WorldSettings::CHUNK_WIDTH*WorldSettings::CHUNK_HEIGHT*WorldSettings::CHUNK_DEPTH> blocks;
+    // written by the worker generating the chunk, then by edits on the render thread or the edit pool
+    // while workers mesh this chunk or a neighbour. relaxed atomics like light, a mesh that saw half an
+    // edit is redone since the edit marks its sections dirty. read through blockAt or getBlock
+    std::array<std::atomic<BlockType>, WorldSettings::CHUNK_SIZE> blocks;
+    // sky light in the high nibble, block light in the low one, same layout as blocks. filled by the
+    // worker before generated is set, after that only the render thread's light passes write it.
+    // workers meshing this chunk or a neighbour read it meanwhile, so cells are relaxed atomics (plain
+    // byte moves). a mesh that saw half a pass is redone, the pass marks the sections it touched dirty
+    std::array<std::atomic<uint8_t>, WorldSettings::CHUNK_SIZE> light{};
+    // index into blocks and light
+    static int cellIndex(int x, int y, int z) { return x + WorldSettings::CHUNK_WIDTH * (y + WorldSettings::CHUNK_HEIGHT * z); }
 
     void generate();
+    // raw write, the world marks the right sections dirty
+    void setBlock(int x, int y, int z, BlockType type);
+    // y of the grass block at a world column, the far terrain samples the same function
+    static int surfaceHeight(const FastNoiseLite& noise, int worldX, int worldZ);
+    // the terrain noise settings generate() and surfaceHeight expect
+    static void setupNoise(FastNoiseLite& noise, int seed);
     void buildMesh();
-    void draw(Shader& shader, GLuint& atlasText);
+    // around[(dx + 1) + 3 * (dz + 1)] is the chunk at (chunkX + dx, chunkZ + dz) or nullptr, the
+    // middle one is ignored. occlusion turns corner shading on for full resolution meshes
+    void buildMesh(std::array<const Chunk*, 9> around, bool occlusion);
+    // the mesh the last build produced, until setData hands it over to the GPU. empty when the build
+    // went straight into the world's staging ring instead
+    const std::vector<Vertex>& meshVertices() const { return verts; }
+    const std::vector<uint32_t>& meshIndices() const { return idx; }
+    // bytes setData is about to upload, wherever the mesh is
+    size_t meshBytes() const;
+    // expects the block shader and atlas to be bound already
+    void draw(Shader& shader);
+    // uploads the mesh and switches to it and its bounds, render thread
     void setData();
+    // the two halves of setData for the world's upload thread: the upload into the pending buffers
+    // there, then the switch on the render thread once the upload's fence has signalled
+    void uploadMesh(Mesh::Slot slot);
+    void publishMesh();
+    // for a mesh that will never be uploaded (the chunk was unloaded), gives back its staging space
+    void discardMesh();
+    // bounds, occluders and visibility of the mesh that just went live. setData and publishMesh do
+    // this themselves, headless tools call it to take them without a GL upload
+    void takeMeshInfo();
     BlockType getBlock(int x, int y, int z) const;
+    // the block at a cellIndex
+    BlockType blockAt(int i) const { return blocks[i].load(std::memory_order_relaxed); }
+    // non-air blocks in a section, kept up to date by setBlock
+    int sectionBlockCount(int section) const { return solidCounts[section].load(std::memory_order_relaxed); }
 
-    bool IsAabbVisible(const std::vector<glm::vec4>& frustumPlanes);
+    // box around the uploaded geometry, y tightened to what the mesh actually covers
+    const AABB& getBox() const { return box; }
+    const std::array<SectionBounds, WorldSettings::SECTION_COUNT>& getSectionBounds() const { return sectionBounds; }
+    // height of the solid run from y=0 under each occluder cell, 0 if the cell has a hole
+    const std::array<uint16_t, WorldSettings::OCCLUDER_CELLS>& getOccluderHeights() const { return occluderHeights; }
+    // 15-bit face-to-face connectivity per section, see SectionVisibility.hpp
+    const std::array<uint16_t, WorldSettings::SECTION_COUNT>& getSectionVisibility() const { return sectionVisibility; }
+    // editTicks as the last uploaded mesh saw it, 0 if no edit went into it
+    int64_t meshedEditTicks() const { return meshEditTicks; }
+    bool hasGeometry() const { return mesh.getIndexCount() > 0; }
+    size_t triangleCount() const { return size_t(mesh.getIndexCount()) / 3; }
     std::vector<glm::vec3> GetAABBVertices(const AABB& box);
 
+    // priority the next remesh is queued at (render thread only)
+    QueuePriority remeshPriority = QueuePriority::Normal;
+    // slot of this chunk's box in the world's FrustumCuller
+    uint32_t cullSlot = 0;
+    // sections reached by the CaveCuller search on frame caveFrame (render thread only)
+    uint32_t caveFrame = 0;
+    uint16_t caveVisited = 0;
+    // scratch for DrawSorter (render thread only)
+    uint32_t sortStamp = 0;
+
     private:
     inline int index(int x, int y, int z) const;
-    void addFaceQuad(std::vector<Vertex>& verts, std::vector<uint32_t>& idx, int x, int y, int z, int dir, BlockType type);
+    // light is the packed sky/block byte of the cell the face looks into, occlusion the
+    // ambient occlusion of each of the face's corners (0..3, 3 is open) in vertexOffsets order
+    void addFaceQuad(std::vector<Vertex>& verts, std::vector<uint32_t>& idx, int x, int y, int z, int dir, BlockType type, int scale, uint8_t light,
+                     const std::array<uint8_t, 4>& occlusion);
     void addFaceQuad(std::vector<Vertex>& verts, std::vector<uint32_t>& idx, std::array<glm::vec3, 4>& corners, int faceDir, BlockType type);
     void greedy();
-    void setBlock(int x, int y, int z, BlockType type);
+    // emits the faces of one section of a (16/scale, 256/scale, 16/scale) grid of cells,
+    // sample(x, y, z) may be asked for cells one step outside the chunk horizontally (on both
+    // axes at once when occlusion is on) and lightAt(x, y, z) for the packed light of any air
+    // cell sample can return
+    template <class Sample, class LightAt>
+    void meshSection(int scale, int section, bool occlusion, Sample&& sample, LightAt&& lightAt);
+    // dominant block of every scale^3 cell
+    void downsample(int scale, std::vector<BlockType>& cells) const;
+    void growSectionBounds(int section, float lo, float hi);
+    void buildOccluders();
+    void buildSectionVisibility(int section);
+
+    // each section keeps its own faces so an edit only remeshes the sections it touched,
+    // buildMesh stitches them into verts/idx for the upload
+    struct SectionMesh
+    {
+        std::vector<Vertex> verts;
+        std::vector<uint32_t> idx;
+    };
+    std::array<SectionMesh, WorldSettings::SECTION_COUNT> sectionMeshes;
+    // level the section meshes were built at, -1 before the first mesh (worker only)
+    int meshedLod = -1;
+    int64_t meshEditTicks = 0;
+
+    // only ever one writer at a time, like blocks
+    std::array<std::atomic<uint16_t>, WorldSettings::SECTION_COUNT> solidCounts{};
 
     std::vector<Vertex> verts;
     std::vector<uint32_t> idx;
+    // where buildMesh put the mesh when the staging ring had room, verts and idx are empty then
+    StagingRing::Allocation staged;
+    uint32_t stagedVertices = 0, stagedIndices = 0;
+    // filled by the worker while meshing, copied over in setData with the mesh
+    std::array<SectionBounds, WorldSettings::SECTION_COUNT> meshSectionBounds;
+    std::array<SectionBounds, WorldSettings::SECTION_COUNT> sectionBounds;
+    std::array<uint16_t, WorldSettings::OCCLUDER_CELLS> meshOccluderHeights{};
+    std::array<uint16_t, WorldSettings::OCCLUDER_CELLS> occluderHeights{};
+    std::array<uint16_t, WorldSettings::SECTION_COUNT> meshSectionVisibility;
+    std::array<uint16_t, WorldSettings::SECTION_COUNT> sectionVisibility;
 
     AABB box;          
     Mesh mesh;
-    World& world;
+    // nullptr for a chunk outside any world
+    World* world = nullptr;
     FastNoiseLite& noise;
 };
\ No newline at end of file
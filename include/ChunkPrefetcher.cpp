@@ -0,0 +1,104 @@
+#include "ChunkPrefetcher.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "WorldConfig.hpp"
+
+namespace
+{
+  // seconds for the smoothed velocity to mostly catch up with a change
+  constexpr double SMOOTHING = 0.25;
+  // anything faster is a teleport, not a flight
+  constexpr float MAX_SPEED = 500.0f;
+  // share of the predicted heading that comes from the view rather than the velocity
+  constexpr float VIEW_WEIGHT = 0.3f;
+
+  int chunkOf(float blocks)
+  {
+    return int(std::floor(blocks / float(WorldSettings::CHUNK_WIDTH)));
+  }
+}
+
+void ChunkPrefetcher::observe(const glm::vec3 &position, const glm::vec3 &viewDirection, double seconds)
+{
+  view = viewDirection;
+  const double dt = seconds - lastSeconds;
+  if (lastSeconds < 0.0 || dt <= 0.0)
+  {
+    lastPosition = position;
+    lastSeconds = seconds;
+    return;
+  }
+  const glm::vec3 instant = (position - lastPosition) / float(dt);
+  lastPosition = position;
+  lastSeconds = seconds;
+  if (glm::length(instant) > MAX_SPEED)
+  {
+    smoothedVelocity = glm::vec3(0.0f);
+    return;
+  }
+  smoothedVelocity = glm::mix(smoothedVelocity, instant, float(1.0 - std::exp(-dt / SMOOTHING)));
+}
+
+void ChunkPrefetcher::predict(int centerX, int centerZ, int radius, std::vector<std::pair<int, int>> &out) const
+{
+  out.clear();
+  const glm::vec2 velocity(smoothedVelocity.x, smoothedVelocity.z);
+  const float speed = glm::length(velocity);
+  if (speed < MIN_SPEED)
+  {
+    return;
+  }
+  glm::vec2 heading = velocity / speed;
+  const glm::vec2 look(view.x, view.z);
+  if (glm::length(look) > 0.1f)
+  {
+    const glm::vec2 blended = glm::mix(heading, glm::normalize(look), VIEW_WEIGHT);
+    // looking straight back against the motion cancels out, keep the velocity then
+    if (glm::length(blended) > 0.1f)
+    {
+      heading = glm::normalize(blended);
+    }
+  }
+
+  const float reachBlocks = float(REACH * WorldSettings::CHUNK_WIDTH);
+  const float distance = std::min(speed * LOOKAHEAD_SECONDS, reachBlocks);
+  const glm::vec2 start(lastPosition.x, lastPosition.z);
+  // half a chunk per step so no centre along the way is skipped
+  const int steps = std::max(1, int(std::ceil(distance / (WorldSettings::CHUNK_WIDTH * 0.5f))));
+
+  int lastX = centerX, lastZ = centerZ;
+  for (int s = 1; s <= steps; s++)
+  {
+    const glm::vec2 at = start + heading * (distance * float(s) / float(steps));
+    const int cx = chunkOf(at.x), cz = chunkOf(at.y);
+    if (cx == lastX && cz == lastZ)
+    {
+      continue;
+    }
+    // the strips this centre adds over the previous one that the current square lacks. the path is
+    // a straight line, so a chunk that left an earlier square never comes back into a later one
+    const size_t stepBegin = out.size();
+    for (int z = cz - radius; z <= cz + radius; z++)
+    {
+      for (int x = cx - radius; x <= cx + radius; x++)
+      {
+        const bool inCurrent = std::abs(x - centerX) <= radius && std::abs(z - centerZ) <= radius;
+        const bool inPrevious = std::abs(x - lastX) <= radius && std::abs(z - lastZ) <= radius;
+        if (!inCurrent && !inPrevious)
+        {
+          out.emplace_back(x, z);
+        }
+      }
+    }
+    // along a strip, the chunks straight ahead of the camera are the ones it sees first
+    std::sort(out.begin() + stepBegin, out.end(), [&](const auto &a, const auto &b)
+              {
+                const int da = (a.first - cx) * (a.first - cx) + (a.second - cz) * (a.second - cz);
+                const int db = (b.first - cx) * (b.first - cx) + (b.second - cz) * (b.second - cz);
+                return da < db;
+              });
+    lastX = cx;
+    lastZ = cz;
+  }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+#include <libs/glm/glm.hpp>
+
+/*
+    Guesses which chunks the loaded square is about to take in, so the world
+    can generate them while the workers would otherwise be idle. The camera
+    velocity is smoothed over a few frames and extrapolated LOOKAHEAD_SECONDS
+    ahead, leaning a little towards where the camera looks (turning shows in
+    the view before it shows in the velocity). Every chunk the square would
+    cover along that path and doesn't cover now is a candidate, the ones the
+    camera reaches first come first.
+
+    Pure bookkeeping, the world decides what to actually queue.
+*/
+class ChunkPrefetcher
+{
+    public:
+    static constexpr float LOOKAHEAD_SECONDS = 2.5f;
+    // slower than this (blocks per second) and nothing is predicted, walking never outruns the loader
+    static constexpr float MIN_SPEED = 6.0f;
+    // how far past the square a prediction may reach, in chunks
+    static constexpr int REACH = 4;
+
+    // render thread, once per frame. seconds is any steady clock
+    void observe(const glm::vec3& position, const glm::vec3& viewDirection, double seconds);
+    // chunks outside the square of radius around (centerX, centerZ) that the square will cover soon,
+    // soonest first
+    void predict(int centerX, int centerZ, int radius, std::vector<std::pair<int, int>>& out) const;
+
+    glm::vec3 velocity() const { return smoothedVelocity; }
+
+    private:
+    glm::vec3 lastPosition{0.0f};
+    double lastSeconds = -1.0;
+    glm::vec3 smoothedVelocity{0.0f};
+    glm::vec3 view{0.0f, 0.0f, -1.0f};
+};
@@ -0,0 +1,99 @@
+#include "ChunkStreamer.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+bool ChunkStreamer::recenter(int chunkX, int chunkZ,
+                             std::vector<std::pair<int, int>> &entering,
+                             std::vector<std::pair<int, int>> &leaving)
+{
+  entering.clear();
+  leaving.clear();
+  if (hasCenter && chunkX == centerX && chunkZ == centerZ)
+  {
+    return false;
+  }
+
+  collectDifference(chunkX, chunkZ, radius, centerX, centerZ, radius, hasCenter, entering);
+  if (hasCenter)
+  {
+    collectDifference(centerX, centerZ, radius, chunkX, chunkZ, radius, true, leaving);
+  }
+  centerX = chunkX;
+  centerZ = chunkZ;
+  hasCenter = true;
+  sortNearestFirst(entering);
+  return true;
+}
+
+bool ChunkStreamer::setRadius(int newRadius,
+                              std::vector<std::pair<int, int>> &entering,
+                              std::vector<std::pair<int, int>> &leaving)
+{
+  entering.clear();
+  leaving.clear();
+  if (newRadius == radius)
+  {
+    return false;
+  }
+  const int oldRadius = radius;
+  radius = newRadius;
+  if (!hasCenter)
+  {
+    return false;
+  }
+  collectDifference(centerX, centerZ, newRadius, centerX, centerZ, oldRadius, true, entering);
+  collectDifference(centerX, centerZ, oldRadius, centerX, centerZ, newRadius, true, leaving);
+  sortNearestFirst(entering);
+  return true;
+}
+
+void ChunkStreamer::sortNearestFirst(std::vector<std::pair<int, int>> &coords) const
+{
+  // load from the player outwards so the ground under them shows up first
+  std::sort(coords.begin(), coords.end(), [&](const auto &a, const auto &b)
+            {
+              int da = (a.first - centerX) * (a.first - centerX) + (a.second - centerZ) * (a.second - centerZ);
+              int db = (b.first - centerX) * (b.first - centerX) + (b.second - centerZ) * (b.second - centerZ);
+              return da < db;
+            });
+}
+
+bool ChunkStreamer::contains(int chunkX, int chunkZ) const
+{
+  return hasCenter && std::abs(chunkX - centerX) <= radius && std::abs(chunkZ - centerZ) <= radius;
+}
+
+void ChunkStreamer::collectDifference(int fromX, int fromZ, int fromRadius, int otherX, int otherZ, int otherRadius, bool otherValid,
+                                      std::vector<std::pair<int, int>> &out) const
+{
+  for (int z = fromZ - fromRadius; z <= fromZ + fromRadius; ++z)
+  {
+    int minX = fromX - fromRadius;
+    int maxX = fromX + fromRadius;
+    // rows outside the other square are entirely new
+    if (!otherValid || std::abs(z - otherZ) > otherRadius)
+    {
+      for (int x = minX; x <= maxX; ++x)
+      {
+        out.emplace_back(x, z);
+      }
+      continue;
+    }
+    // otherwise only the parts of the row left and right of the other square
+    int overlapMin = std::max(minX, otherX - otherRadius);
+    int overlapMax = std::min(maxX, otherX + otherRadius);
+    if (overlapMin > overlapMax)
+    {
+      overlapMin = maxX + 1;
+      overlapMax = maxX;
+    }
+    for (int x = minX; x < overlapMin; ++x)
+    {
+      out.emplace_back(x, z);
+    }
+    for (int x = overlapMax + 1; x <= maxX; ++x)
+    {
+      out.emplace_back(x, z);
+    }
+  }
+}
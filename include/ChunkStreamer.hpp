@@ -0,0 +1,44 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+/*
+    Tracks the square of chunk coordinates that should be loaded around the
+    player. When the player crosses into a new chunk it only works out the
+    strips that entered or left the square instead of walking the whole
+    (2R+1)^2 window again. Changing the radius works the same way, only the
+    ring between the old and the new square comes or goes.
+*/
+class ChunkStreamer
+{
+    public:
+    explicit ChunkStreamer(int radius) : radius(radius) {}
+
+    // returns false if the centre chunk did not change. entering is sorted nearest first
+    bool recenter(int chunkX, int chunkZ,
+                  std::vector<std::pair<int, int>>& entering,
+                  std::vector<std::pair<int, int>>& leaving);
+
+    // grows or shrinks the square around the current centre. returns false if nothing changed
+    // (or there is no centre yet, the next recenter uses the new radius)
+    bool setRadius(int newRadius,
+                   std::vector<std::pair<int, int>>& entering,
+                   std::vector<std::pair<int, int>>& leaving);
+
+    bool contains(int chunkX, int chunkZ) const;
+    int getRadius() const { return radius; }
+    int getCenterX() const { return centerX; }
+    int getCenterZ() const { return centerZ; }
+
+    private:
+    // appends every coord of the square of fromRadius around (fromX, fromZ) that is not in the
+    // square of otherRadius around (otherX, otherZ)
+    void collectDifference(int fromX, int fromZ, int fromRadius, int otherX, int otherZ, int otherRadius, bool otherValid,
+                           std::vector<std::pair<int, int>>& out) const;
+    void sortNearestFirst(std::vector<std::pair<int, int>>& coords) const;
+
+    int radius;
+    int centerX = 0, centerZ = 0;
+    bool hasCenter = false;
+};
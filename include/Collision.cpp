@@ -0,0 +1,132 @@
+#include "Collision.hpp"
+#include "Chunk.hpp"
+#include "World.hpp"
+#include "WorldAccessor.hpp"
+#include "WorldConfig.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  // keeps a face that lands exactly on a block boundary from counting the block past it
+  constexpr float kEpsilon = 1e-4f;
+}
+
+VoxelCollider::VoxelCollider(World &world) : access(world) {}
+
+bool VoxelCollider::isSolid(int x, int y, int z)
+{
+  if (y < 0)
+  {
+    return true;
+  }
+  if (y >= WorldSettings::CHUNK_HEIGHT)
+  {
+    return false;
+  }
+  // NoBlock (not loaded or not generated) is solid too
+  return access.getBlock(x, y, z) != BlockType::Air;
+}
+
+float VoxelCollider::sweepAxis(const AABB &box, int axis, float distance)
+{
+  if (distance == 0.0f)
+  {
+    return 0.0f;
+  }
+  const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+  const int u0 = int(std::floor(box.vmin[u] + kEpsilon)), u1 = int(std::floor(box.vmax[u] - kEpsilon));
+  const int v0 = int(std::floor(box.vmin[v] + kEpsilon)), v1 = int(std::floor(box.vmax[v] - kEpsilon));
+
+  auto layerBlocked = [&](int layer)
+  {
+    glm::ivec3 p;
+    p[axis] = layer;
+    for (p[v] = v0; p[v] <= v1; ++p[v])
+    {
+      for (p[u] = u0; p[u] <= u1; ++p[u])
+      {
+        if (isSolid(p.x, p.y, p.z))
+        {
+          return true;
+        }
+      }
+    }
+    return false;
+  };
+
+  // walk the layers of blocks the leading face enters, nearest first, and stop at the first solid one
+  if (distance > 0.0f)
+  {
+    const float edge = box.vmax[axis];
+    const int first = int(std::ceil(edge - kEpsilon));
+    const int last = int(std::ceil(edge + distance)) - 1;
+    for (int layer = first; layer <= last; ++layer)
+    {
+      if (layerBlocked(layer))
+      {
+        return std::max(0.0f, float(layer) - edge);
+      }
+    }
+  }
+  else
+  {
+    const float edge = box.vmin[axis];
+    const int first = int(std::floor(edge + kEpsilon)) - 1;
+    const int last = int(std::floor(edge + distance));
+    for (int layer = first; layer >= last; --layer)
+    {
+      if (layerBlocked(layer))
+      {
+        return std::min(0.0f, float(layer + 1) - edge);
+      }
+    }
+  }
+  return distance;
+}
+
+glm::vec3 VoxelCollider::move(const AABB &box, const glm::vec3 &delta, glm::bvec3 &blocked)
+{
+  // y first so walking into a wall while falling still lands on the floor
+  AABB moving = box;
+  glm::vec3 moved(0.0f);
+  for (int axis : {1, 0, 2})
+  {
+    float d = sweepAxis(moving, axis, delta[axis]);
+    blocked[axis] = d != delta[axis];
+    moving.vmin[axis] += d;
+    moving.vmax[axis] += d;
+    moved[axis] = d;
+  }
+  return moved;
+}
+
+void VoxelCollider::step(Body &body, float dt, float gravity)
+{
+  body.velocity.y -= gravity * dt;
+  const glm::vec3 wanted = body.velocity * dt;
+  glm::bvec3 blocked(false);
+  body.position += move(body.box(), wanted, blocked);
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    if (blocked[axis])
+    {
+      body.velocity[axis] = 0.0f;
+    }
+  }
+  body.onGround = blocked.y && wanted.y < 0.0f;
+}
+
+void VoxelCollider::stepAll(World &world, std::vector<Body> &bodies, float dt, float gravity)
+{
+  // one collider per batch, so each keeps its own cached chunks
+  constexpr size_t batch = 256;
+  world.parallelFor((bodies.size() + batch - 1) / batch, [&](size_t b)
+                    {
+    VoxelCollider collider(world);
+    const size_t end = std::min(bodies.size(), (b + 1) * batch);
+    for (size_t i = b * batch; i < end; ++i)
+    {
+      collider.step(bodies[i], dt, gravity);
+    } });
+}
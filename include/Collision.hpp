@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <libs/glm/glm.hpp>
+#include "VoxelTypes.hpp"
+#include "WorldAccessor.hpp"
+
+class World;
+
+// an axis-aligned box that moves through the voxels, position is the centre of the box
+struct Body
+{
+    glm::vec3 position{0.0f};
+    glm::vec3 halfExtents{0.3f, 0.9f, 0.3f};
+    glm::vec3 velocity{0.0f};
+    bool onGround = false;
+
+    AABB box() const { return AABB{position - halfExtents, position + halfExtents}; }
+};
+
+/*
+    Swept AABB against the block grid. A move is split into its y, x and z
+    parts and each is clamped in turn against the layers of blocks the box's
+    leading face would cross, which gives sliding along walls and floors for
+    free. Blocks the box already overlaps are ignored, so something stuck
+    inside terrain can still move out.
+
+    Block reads go through a WorldAccessor, so they only hit the world's map
+    when a query lands in a column it hasn't seen. The accessor holds back
+    chunk frees while it lives, so make a collider per tick (or per batch)
+    rather than keeping one around.
+*/
+class VoxelCollider
+{
+    public:
+    explicit VoxelCollider(World& world);
+
+    // moves box by delta as far as the blocks allow and returns the distance actually moved.
+    // blocked is set for every axis that was cut short
+    glm::vec3 move(const AABB& box, const glm::vec3& delta, glm::bvec3& blocked);
+    // gravity, then move, then zero the velocity on blocked axes
+    void step(Body& body, float dt, float gravity = 25.0f);
+
+    // unloaded or not yet generated counts as solid so nothing falls out of the world while it streams
+    bool isSolid(int x, int y, int z);
+
+    // many bodies at once, spread over the world's worker pool
+    static void stepAll(World& world, std::vector<Body>& bodies, float dt, float gravity = 25.0f);
+
+    private:
+    float sweepAxis(const AABB& box, int axis, float distance);
+
+    WorldAccessor access;
+};
@@ -0,0 +1,111 @@
+#include "DrawSorter.hpp"
+#include "Chunk.hpp"
+#include <algorithm>
+#include <utility>
+
+void DrawSorter::sort(std::vector<Chunk *> &items, const glm::vec3 &cameraPos)
+{
+  // two stamps per call: "in this frame's list" and "already taken from last frame's order"
+  stamp += 2;
+  const uint32_t listed = stamp;
+  const uint32_t placed = stamp + 1;
+  for (Chunk *chunk : items)
+  {
+    chunk->sortStamp = listed;
+  }
+
+  // last frame's order first, then whatever just came into view
+  seeded.clear();
+  for (Chunk *chunk : previous)
+  {
+    if (chunk->sortStamp == listed)
+    {
+      chunk->sortStamp = placed;
+      seeded.push_back(chunk);
+    }
+  }
+  for (Chunk *chunk : items)
+  {
+    if (chunk->sortStamp == listed)
+    {
+      seeded.push_back(chunk);
+    }
+  }
+
+  const size_t n = seeded.size();
+  keys.resize(n);
+  size_t descents = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    keys[i] = keyFor(*seeded[i], cameraPos);
+    if (i > 0 && keys[i] < keys[i - 1])
+    {
+      descents++;
+    }
+  }
+
+  incremental = descents <= n / 32 + 4;
+  if (incremental)
+  {
+    // nearly sorted: insertion sort only moves the few items that changed place
+    for (size_t i = 1; i < n; ++i)
+    {
+      uint16_t key = keys[i];
+      Chunk *chunk = seeded[i];
+      size_t j = i;
+      for (; j > 0 && keys[j - 1] > key; --j)
+      {
+        keys[j] = keys[j - 1];
+        seeded[j] = seeded[j - 1];
+      }
+      keys[j] = key;
+      seeded[j] = chunk;
+    }
+  }
+  else
+  {
+    radixSort();
+  }
+
+  items.assign(seeded.begin(), seeded.end());
+  previous = items;
+}
+
+uint16_t DrawSorter::keyFor(const Chunk &chunk, const glm::vec3 &cameraPos) const
+{
+  // distance to the closest point of the box, in 1/16 block steps
+  const AABB &box = chunk.getBox();
+  glm::vec3 closest = glm::clamp(cameraPos, box.vmin, box.vmax);
+  float scaled = glm::length(closest - cameraPos) * 16.0f;
+  uint16_t key = uint16_t(std::min(scaled, 65535.0f));
+  return order == SortOrder::FrontToBack ? key : uint16_t(65535 - key);
+}
+
+void DrawSorter::radixSort()
+{
+  const size_t n = keys.size();
+  scratchKeys.resize(n);
+  scratchItems.resize(n);
+
+  // two stable 8-bit passes, low byte then high byte
+  for (int shift = 0; shift < 16; shift += 8)
+  {
+    size_t offsets[257] = {};
+    for (uint16_t key : keys)
+    {
+      offsets[((key >> shift) & 0xFF) + 1]++;
+    }
+    for (int b = 0; b < 256; ++b)
+    {
+      offsets[b + 1] += offsets[b];
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+      size_t dst = offsets[(keys[i] >> shift) & 0xFF]++;
+      scratchKeys[dst] = keys[i];
+      scratchItems[dst] = seeded[i];
+    }
+    std::swap(keys, scratchKeys);
+    std::swap(seeded, scratchItems);
+  }
+}
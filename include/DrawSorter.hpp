@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <libs/glm/glm.hpp>
+
+class Chunk;
+
+enum class SortOrder { FrontToBack, BackToFront };
+
+/*
+    Orders a pass's draw list by quantized distance to the camera. Opaque
+    geometry goes front to back so early-Z can reject hidden fragments. A
+    transparent pass would own its own sorter set to BackToFront.
+
+    The camera barely moves between frames, so last frame's order is almost
+    right. We start from it and finish with an insertion sort when only a few
+    neighbours are out of place, or a 2-pass 8-bit radix sort when many are.
+*/
+class DrawSorter
+{
+    public:
+    explicit DrawSorter(SortOrder order = SortOrder::FrontToBack) : order(order) {}
+
+    void sort(std::vector<Chunk*>& items, const glm::vec3& cameraPos);
+    // drop last frame's order, needed whenever chunks it points at may have been freed
+    void reset() { previous.clear(); }
+
+    // how the last sort was finished, for stats
+    bool lastWasIncremental() const { return incremental; }
+
+    private:
+    uint16_t keyFor(const Chunk& chunk, const glm::vec3& cameraPos) const;
+    void radixSort();
+
+    SortOrder order;
+    std::vector<Chunk*> previous;
+    uint32_t stamp = 0;
+    bool incremental = false;
+
+    // scratch reused across frames
+    std::vector<Chunk*> seeded, scratchItems;
+    std::vector<uint16_t> keys, scratchKeys;
+};
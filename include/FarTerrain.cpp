@@ -0,0 +1,277 @@
+#include "FarTerrain.hpp"
+#include "Chunk.hpp"
+#include "scripts/Loader.h"
+#include <cmath>
+#include <libs/glm/gtc/type_ptr.hpp>
+
+namespace
+{
+  constexpr int kMask = FarTerrain::TEXELS - 1;
+  constexpr int kVerts = FarTerrain::CELLS + 1;
+
+  // texel ranges whose cells are new when a TEXELS wide window slides from `from` to `to`
+  void exposedRanges(int from, int to, bool full, std::vector<glm::ivec2> &out)
+  {
+    out.clear();
+    int shift = to - from;
+    if (full || std::abs(shift) >= FarTerrain::TEXELS)
+    {
+      out.push_back({0, FarTerrain::TEXELS});
+      return;
+    }
+    if (shift == 0)
+    {
+      return;
+    }
+    int firstCell = shift > 0 ? from + FarTerrain::TEXELS : to;
+    int count = std::abs(shift);
+    int begin = firstCell & kMask;
+    if (begin + count <= FarTerrain::TEXELS)
+    {
+      out.push_back({begin, begin + count});
+    }
+    else
+    {
+      out.push_back({begin, FarTerrain::TEXELS});
+      out.push_back({0, begin + count - FarTerrain::TEXELS});
+    }
+  }
+
+  // world cell that texel t holds while the window starts at `start`
+  int cellForTexel(int t, int start)
+  {
+    return start + ((t - start) & kMask);
+  }
+}
+
+FarTerrain::FarTerrain(const FastNoiseLite &noise, SafeQueue<ChunkJob> &jobs)
+    : noise(noise), jobs(jobs),
+      shader(Loader::getPath("shaders/terrain.vs"), Loader::getPath("shaders/terrain.fs"))
+{
+  std::vector<glm::vec2> grid;
+  grid.reserve(kVerts * kVerts);
+  for (int j = 0; j < kVerts; ++j)
+  {
+    for (int i = 0; i < kVerts; ++i)
+    {
+      grid.push_back(glm::vec2(i, j));
+    }
+  }
+
+  glGenVertexArrays(1, &VAO);
+  glGenBuffers(1, &VBO);
+  glBindVertexArray(VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  glBufferData(GL_ARRAY_BUFFER, grid.size() * sizeof(glm::vec2), grid.data(), GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void *)0);
+  glBindVertexArray(0);
+
+  for (int l = 0; l < LEVELS; ++l)
+  {
+    Level &level = levels[l];
+    level.spacing = WorldSettings::FAR_SPACING << l;
+    level.heights.assign(TEXELS * TEXELS, 0.0f);
+
+    glGenTextures(1, &level.texture);
+    glBindTexture(GL_TEXTURE_2D, level.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, TEXELS, TEXELS, 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glGenBuffers(1, &level.EBO);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+FarTerrain::~FarTerrain()
+{
+  for (Level &level : levels)
+  {
+    glDeleteTextures(1, &level.texture);
+    glDeleteBuffers(1, &level.EBO);
+  }
+  glDeleteBuffers(1, &VBO);
+  glDeleteVertexArrays(1, &VAO);
+}
+
+glm::ivec2 FarTerrain::targetOrigin(int level, const glm::vec3 &cameraPos) const
+{
+  const float spacing = float(levels[level].spacing);
+  glm::ivec2 cell(int(std::floor(cameraPos.x / spacing)), int(std::floor(cameraPos.z / spacing)));
+  // even so every vertex of the next level out lands on one of ours
+  return (cell - glm::ivec2(CELLS / 2)) & glm::ivec2(~1);
+}
+
+void FarTerrain::fillLevel(Level &level, glm::ivec2 from, glm::ivec2 to, bool full)
+{
+  exposedRanges(from.x, to.x, full, level.dirtyColumns);
+  exposedRanges(from.y, to.y, full, level.dirtyRows);
+
+  auto sample = [&](int tx, int tz)
+  {
+    int worldX = cellForTexel(tx, to.x) * level.spacing;
+    int worldZ = cellForTexel(tz, to.y) * level.spacing;
+    // +1 for the top face of the grass block
+    level.heights[tx + TEXELS * tz] = float(Chunk::surfaceHeight(noise, worldX, worldZ) + 1);
+  };
+  for (const glm::ivec2 &range : level.dirtyColumns)
+  {
+    for (int tz = 0; tz < TEXELS; ++tz)
+    {
+      for (int tx = range.x; tx < range.y; ++tx)
+      {
+        sample(tx, tz);
+      }
+    }
+  }
+  for (const glm::ivec2 &range : level.dirtyRows)
+  {
+    for (int tz = range.x; tz < range.y; ++tz)
+    {
+      for (int tx = 0; tx < TEXELS; ++tx)
+      {
+        sample(tx, tz);
+      }
+    }
+  }
+  level.ready = true;
+}
+
+void FarTerrain::uploadLevel(Level &level)
+{
+  glBindTexture(GL_TEXTURE_2D, level.texture);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, TEXELS);
+  for (const glm::ivec2 &range : level.dirtyColumns)
+  {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, range.x, 0, range.y - range.x, TEXELS, GL_RED, GL_FLOAT,
+                    level.heights.data() + range.x);
+  }
+  for (const glm::ivec2 &range : level.dirtyRows)
+  {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, range.x, TEXELS, range.y - range.x, GL_RED, GL_FLOAT,
+                    level.heights.data() + range.x * TEXELS);
+  }
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+glm::ivec4 FarTerrain::holeFor(int l, const glm::vec2 &holeMin, const glm::vec2 &holeMax) const
+{
+  const Level &level = levels[l];
+  if (l == 0)
+  {
+    // only quads that lie completely inside the chunk square, the rest overlap the chunks a little
+    const float s = float(level.spacing);
+    glm::ivec2 lo = glm::ivec2(glm::ceil(holeMin / s)) - level.origin;
+    glm::ivec2 hi = glm::ivec2(glm::floor(holeMax / s)) - level.origin;
+    return glm::ivec4(lo, hi);
+  }
+  const Level &finer = levels[l - 1];
+  if (!finer.valid)
+  {
+    return glm::ivec4(0);
+  }
+  // the finer origin is even, so it sits on one of our vertices and covers CELLS / 2 of our quads
+  glm::ivec2 lo = finer.origin / 2 - level.origin;
+  return glm::ivec4(lo, lo + glm::ivec2(CELLS / 2));
+}
+
+void FarTerrain::buildIndices(Level &level, const glm::ivec4 &hole)
+{
+  scratchIndices.clear();
+  for (int j = 0; j < CELLS; ++j)
+  {
+    for (int i = 0; i < CELLS; ++i)
+    {
+      if (i >= hole.x && i < hole.z && j >= hole.y && j < hole.w)
+      {
+        continue;
+      }
+      uint32_t v = uint32_t(j * kVerts + i);
+      // counter-clockwise seen from above
+      scratchIndices.insert(scratchIndices.end(), {v, v + kVerts, v + 1, v + 1, v + kVerts, v + kVerts + 1});
+    }
+  }
+  // element buffer bindings live in the VAO, bind ours so a chunk's VAO left bound isn't touched
+  glBindVertexArray(VAO);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, level.EBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, scratchIndices.size() * sizeof(uint32_t), scratchIndices.data(), GL_DYNAMIC_DRAW);
+  glBindVertexArray(0);
+  level.indexCount = GLsizei(scratchIndices.size());
+  level.hole = hole;
+  level.indicesBuilt = true;
+}
+
+int FarTerrain::update(const glm::vec3 &cameraPos, const glm::vec2 &holeMin, const glm::vec2 &holeMax)
+{
+  int resampled = 0;
+  for (int l = 0; l < LEVELS; ++l)
+  {
+    Level &level = levels[l];
+    if (level.pending && level.ready.load())
+    {
+      uploadLevel(level);
+      level.ready = false;
+      level.pending = false;
+      level.origin = level.pendingOrigin;
+      level.valid = true;
+      resampled++;
+    }
+
+    // one fill in flight per level, it owns the heights until it reports back
+    glm::ivec2 target = targetOrigin(l, cameraPos);
+    if (!level.pending && (!level.valid || target != level.origin))
+    {
+      level.pending = true;
+      level.pendingOrigin = target;
+      glm::ivec2 from = level.valid ? level.origin : target;
+      bool full = !level.valid;
+      jobs.push(ChunkJob{nullptr, JobType::Task, [this, &level, from, target, full]
+                         { fillLevel(level, from, target, full); }});
+    }
+  }
+
+  // holes depend on the level inside, so these go after every origin has settled for the frame
+  for (int l = 0; l < LEVELS; ++l)
+  {
+    Level &level = levels[l];
+    if (!level.valid)
+    {
+      continue;
+    }
+    glm::ivec4 hole = holeFor(l, holeMin, holeMax);
+    if (!level.indicesBuilt || hole != level.hole)
+    {
+      buildIndices(level, hole);
+    }
+  }
+  return resampled;
+}
+
+void FarTerrain::draw(const glm::mat4 &viewProjection, const glm::vec3 &cameraPos)
+{
+  shader.use();
+  shader.setMat4("viewProjection", viewProjection);
+  shader.setVec3("cameraPos", cameraPos);
+  shader.setInt("heights", 0);
+  shader.setInt("gridCells", CELLS);
+  shader.setInt("texelMask", kMask);
+  shader.setFloat("fogEnd", VIEW_DISTANCE);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindVertexArray(VAO);
+  for (const Level &level : levels)
+  {
+    if (!level.valid || level.indexCount == 0)
+    {
+      continue;
+    }
+    glBindTexture(GL_TEXTURE_2D, level.texture);
+    glUniform2i(glGetUniformLocation(shader.ID, "origin"), level.origin.x, level.origin.y);
+    shader.setFloat("spacing", float(level.spacing));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, level.EBO);
+    glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, 0);
+  }
+  glBindVertexArray(0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
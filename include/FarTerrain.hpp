@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include <libs/glad/glad.h>
+#include <libs/glm/glm.hpp>
+#include "FastNoiseLite.h"
+#include "SafeQueue.hpp"
+#include "VoxelTypes.hpp"
+#include "WorldConfig.hpp"
+#include "shader_m.h"
+
+/*
+    Draws the terrain past the loaded chunks as a clipmap: FAR_LEVELS square
+    grids centred on the camera, each with twice the vertex spacing of the
+    one inside it. A level leaves a hole where the finer level (or, for
+    level 0, the meshed chunks) already covers the ground.
+
+    Heights come from Chunk::surfaceHeight, so the far field lines up with
+    the voxels once they load. Each level keeps its heights in a TEXELS^2
+    ring buffer addressed by world cell & (TEXELS - 1). When the camera
+    moves only the rows and columns that scrolled into view are sampled, on
+    the world's worker pool, and only those are uploaded. Memory stays fixed
+    no matter how far the player travels.
+*/
+class FarTerrain
+{
+    public:
+    static constexpr int LEVELS = WorldSettings::FAR_LEVELS;
+    static constexpr int TEXELS = 64;
+    // quads per side, two short of TEXELS so it stays even and a level lines up with the next one out
+    static constexpr int CELLS = TEXELS - 2;
+    // distance from the camera to the edge of the outer level
+    static constexpr float VIEW_DISTANCE = float(WorldSettings::FAR_SPACING << (LEVELS - 1)) * (CELLS / 2);
+
+    FarTerrain(const FastNoiseLite& noise, SafeQueue<ChunkJob>& jobs);
+    ~FarTerrain();
+
+    FarTerrain(const FarTerrain&) = delete;
+    FarTerrain& operator=(const FarTerrain&) = delete;
+
+    // render thread: uploads finished levels and queues the ones the camera has moved away from.
+    // holeMin/holeMax is the xz square the meshed chunks cover. returns the levels re-sampled
+    int update(const glm::vec3& cameraPos, const glm::vec2& holeMin, const glm::vec2& holeMax);
+    // the caller clears depth afterwards, the far field uses its own near/far planes
+    void draw(const glm::mat4& viewProjection, const glm::vec3& cameraPos);
+
+    private:
+    struct Level
+    {
+        int spacing = 1;
+        // world cell (in units of spacing) of grid vertex (0,0) for what is on the GPU
+        glm::ivec2 origin{0};
+        glm::ivec2 pendingOrigin{0};
+        bool valid = false;
+        bool pending = false;
+        // set by the worker once heights and the dirty ranges below are filled in
+        std::atomic<bool> ready{false};
+
+        std::vector<float> heights;
+        // texel ranges [x, y) the last fill touched
+        std::vector<glm::ivec2> dirtyColumns, dirtyRows;
+
+        GLuint texture = 0;
+        GLuint EBO = 0;
+        GLsizei indexCount = 0;
+        // quads left out for the hole, [min, max) in grid coordinates
+        glm::ivec4 hole{0};
+        bool indicesBuilt = false;
+    };
+
+    glm::ivec2 targetOrigin(int level, const glm::vec3& cameraPos) const;
+    // worker: samples the cells that are new when the window moves from `from` to `to`
+    void fillLevel(Level& level, glm::ivec2 from, glm::ivec2 to, bool full);
+    void uploadLevel(Level& level);
+    void buildIndices(Level& level, const glm::ivec4& hole);
+    glm::ivec4 holeFor(int level, const glm::vec2& holeMin, const glm::vec2& holeMax) const;
+
+    const FastNoiseLite& noise;
+    SafeQueue<ChunkJob>& jobs;
+    std::array<Level, LEVELS> levels;
+    std::vector<uint32_t> scratchIndices;
+
+    Shader shader;
+    // one grid of (i, j) vertices shared by every level
+    GLuint VAO = 0, VBO = 0;
+};
@@ -0,0 +1,207 @@
+#include "FrustumCuller.hpp"
+#include "Chunk.hpp"
+#include <bit>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+  constexpr uint32_t kBatch = 8;
+
+  size_t paddedSize(size_t count)
+  {
+    return (count + kBatch - 1) / kBatch * kBatch;
+  }
+
+  // plane coefficients broadcast once per cull so the batch loop only does loads + math
+  struct PlaneConsts
+  {
+    float nx, ny, nz, w;
+    float ax, ay, az;
+  };
+}
+
+uint32_t FrustumCuller::add(const AABB &box, Chunk *owner)
+{
+  uint32_t slot = uint32_t(owners.size());
+  owners.push_back(owner);
+
+  size_t padded = paddedSize(owners.size());
+  if (centerX.size() < padded)
+  {
+    for (auto *v : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ})
+    {
+      v->resize(padded, 0.0f);
+    }
+  }
+  set(slot, box);
+  return slot;
+}
+
+void FrustumCuller::update(uint32_t slot, const AABB &box)
+{
+  set(slot, box);
+}
+
+void FrustumCuller::remove(uint32_t slot)
+{
+  uint32_t last = uint32_t(owners.size()) - 1;
+  if (slot != last)
+  {
+    owners[slot] = owners[last];
+    owners[slot]->cullSlot = slot;
+    for (auto *v : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ})
+    {
+      (*v)[slot] = (*v)[last];
+    }
+  }
+  owners.pop_back();
+}
+
+void FrustumCuller::set(uint32_t slot, const AABB &box)
+{
+  glm::vec3 c = (box.vmin + box.vmax) * 0.5f;
+  glm::vec3 e = (box.vmax - box.vmin) * 0.5f;
+  centerX[slot] = c.x;
+  centerY[slot] = c.y;
+  centerZ[slot] = c.z;
+  extentX[slot] = e.x;
+  extentY[slot] = e.y;
+  extentZ[slot] = e.z;
+}
+
+bool FrustumCuller::isBoxVisible(const std::vector<glm::vec4> &frustumPlanes, const AABB &box)
+{
+  glm::vec3 c = (box.vmin + box.vmax) * 0.5f;
+  glm::vec3 e = (box.vmax - box.vmin) * 0.5f;
+  for (const glm::vec4 &g : frustumPlanes)
+  {
+    float d = g.x * c.x + g.y * c.y + g.z * c.z + g.w;
+    float r = std::fabs(g.x) * e.x + std::fabs(g.y) * e.y + std::fabs(g.z) * e.z;
+    if (d + r < 0.0f)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void FrustumCuller::cull(const std::vector<glm::vec4> &frustumPlanes, std::vector<uint32_t> &outVisible) const
+{
+  outVisible.clear();
+  const size_t count = owners.size();
+  if (count == 0)
+  {
+    return;
+  }
+
+  std::vector<PlaneConsts> planes;
+  planes.reserve(frustumPlanes.size());
+  for (const glm::vec4 &g : frustumPlanes)
+  {
+    planes.push_back({g.x, g.y, g.z, g.w, std::fabs(g.x), std::fabs(g.y), std::fabs(g.z)});
+  }
+
+  // a box is outside a plane when even its furthest point along the plane normal
+  // is behind it: dot(n, center) + w + dot(|n|, extent) < 0
+  for (size_t base = 0; base < count; base += kBatch)
+  {
+    uint32_t mask = 0;
+
+#if defined(__AVX__)
+    const __m256 cx = _mm256_loadu_ps(&centerX[base]);
+    const __m256 cy = _mm256_loadu_ps(&centerY[base]);
+    const __m256 cz = _mm256_loadu_ps(&centerZ[base]);
+    const __m256 ex = _mm256_loadu_ps(&extentX[base]);
+    const __m256 ey = _mm256_loadu_ps(&extentY[base]);
+    const __m256 ez = _mm256_loadu_ps(&extentZ[base]);
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (const PlaneConsts &p : planes)
+    {
+      __m256 d = _mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(p.nx)), _mm256_mul_ps(cy, _mm256_set1_ps(p.ny)));
+      d = _mm256_add_ps(d, _mm256_add_ps(_mm256_mul_ps(cz, _mm256_set1_ps(p.nz)), _mm256_set1_ps(p.w)));
+      __m256 r = _mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(p.ax)), _mm256_mul_ps(ey, _mm256_set1_ps(p.ay)));
+      r = _mm256_add_ps(r, _mm256_mul_ps(ez, _mm256_set1_ps(p.az)));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+    mask = uint32_t(_mm256_movemask_ps(inside));
+#elif defined(__SSE2__)
+    // two 4-wide halves per batch of 8
+    for (size_t half = 0; half < 2; ++half)
+    {
+      const size_t i = base + half * 4;
+      const __m128 cx = _mm_loadu_ps(&centerX[i]);
+      const __m128 cy = _mm_loadu_ps(&centerY[i]);
+      const __m128 cz = _mm_loadu_ps(&centerZ[i]);
+      const __m128 ex = _mm_loadu_ps(&extentX[i]);
+      const __m128 ey = _mm_loadu_ps(&extentY[i]);
+      const __m128 ez = _mm_loadu_ps(&extentZ[i]);
+      __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+      for (const PlaneConsts &p : planes)
+      {
+        __m128 d = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(p.nx)), _mm_mul_ps(cy, _mm_set1_ps(p.ny)));
+        d = _mm_add_ps(d, _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(p.nz)), _mm_set1_ps(p.w)));
+        __m128 r = _mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(p.ax)), _mm_mul_ps(ey, _mm_set1_ps(p.ay)));
+        r = _mm_add_ps(r, _mm_mul_ps(ez, _mm_set1_ps(p.az)));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+      }
+      mask |= uint32_t(_mm_movemask_ps(inside)) << (half * 4);
+    }
+#elif defined(__ARM_NEON)
+    const uint32x4_t laneBits = {1, 2, 4, 8};
+    for (size_t half = 0; half < 2; ++half)
+    {
+      const size_t i = base + half * 4;
+      const float32x4_t cx = vld1q_f32(&centerX[i]);
+      const float32x4_t cy = vld1q_f32(&centerY[i]);
+      const float32x4_t cz = vld1q_f32(&centerZ[i]);
+      const float32x4_t ex = vld1q_f32(&extentX[i]);
+      const float32x4_t ey = vld1q_f32(&extentY[i]);
+      const float32x4_t ez = vld1q_f32(&extentZ[i]);
+      uint32x4_t inside = vdupq_n_u32(0xFFFFFFFFu);
+      for (const PlaneConsts &p : planes)
+      {
+        float32x4_t d = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(p.w), cx, p.nx), cy, p.ny), cz, p.nz);
+        float32x4_t r = vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(ex, p.ax), ey, p.ay), ez, p.az);
+        inside = vandq_u32(inside, vcgeq_f32(vaddq_f32(d, r), vdupq_n_f32(0.0f)));
+      }
+      mask |= vaddvq_u32(vandq_u32(inside, laneBits)) << (half * 4);
+    }
+#else
+    for (uint32_t lane = 0; lane < kBatch; ++lane)
+    {
+      const size_t i = base + lane;
+      bool inside = true;
+      for (const PlaneConsts &p : planes)
+      {
+        float d = p.nx * centerX[i] + p.ny * centerY[i] + p.nz * centerZ[i] + p.w;
+        float r = p.ax * extentX[i] + p.ay * extentY[i] + p.az * extentZ[i];
+        if (d + r < 0.0f)
+        {
+          inside = false;
+          break;
+        }
+      }
+      mask |= uint32_t(inside) << lane;
+    }
+#endif
+
+    // drop the padding lanes of the last batch
+    if (base + kBatch > count)
+    {
+      mask &= (1u << (count - base)) - 1u;
+    }
+    while (mask)
+    {
+      outVisible.push_back(uint32_t(base) + uint32_t(std::countr_zero(mask)));
+      mask &= mask - 1u;
+    }
+  }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <libs/glm/glm.hpp>
+#include "VoxelTypes.hpp"
+
+class Chunk;
+
+/*
+    Holds every loaded chunk's bounding box as a structure of arrays
+    (center + half extent per axis) so the frustum test can run on 8 boxes
+    at once instead of 8 corner dot products per plane per chunk.
+
+    Each box lives in a slot. Chunks keep their slot in Chunk::cullSlot so
+    the world can update the box when the chunk changes.
+*/
+class FrustumCuller
+{
+    public:
+    // returns the slot the box was stored in
+    uint32_t add(const AABB& box, Chunk* owner);
+    void update(uint32_t slot, const AABB& box);
+    // moves the last box into the freed slot and patches that chunk's cullSlot
+    void remove(uint32_t slot);
+
+    // writes the slots of every box that touches the frustum into outVisible
+    void cull(const std::vector<glm::vec4>& frustumPlanes, std::vector<uint32_t>& outVisible) const;
+
+    // single box test for callers that walk boxes one at a time
+    static bool isBoxVisible(const std::vector<glm::vec4>& frustumPlanes, const AABB& box);
+
+    Chunk* owner(uint32_t slot) const { return owners[slot]; }
+    size_t size() const { return owners.size(); }
+
+    private:
+    void set(uint32_t slot, const AABB& box);
+
+    // padded up to a multiple of 8 so the batch loop never reads past the end
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<Chunk*> owners;
+};
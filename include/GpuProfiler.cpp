@@ -0,0 +1,120 @@
+#include "GpuProfiler.hpp"
+#include <string>
+
+GpuProfiler::GpuProfiler()
+{
+  for (Frame &frame : frames)
+  {
+    for (Queries &queries : frame.passes)
+    {
+      glGenQueries(1, &queries.time);
+      glGenQueries(1, &queries.primitives);
+    }
+  }
+}
+
+GpuProfiler::~GpuProfiler()
+{
+  for (Frame &frame : frames)
+  {
+    for (Queries &queries : frame.passes)
+    {
+      glDeleteQueries(1, &queries.time);
+      glDeleteQueries(1, &queries.primitives);
+    }
+  }
+}
+
+void GpuProfiler::beginFrame()
+{
+  current = (current + 1) % FRAMES_IN_FLIGHT;
+  Frame &frame = frames[current];
+  if (frame.pending)
+  {
+    collect(frame);
+  }
+  frame.passCount = 0;
+}
+
+void GpuProfiler::endFrame()
+{
+  if (inPass)
+  {
+    endPass();
+  }
+  frames[current].pending = frames[current].passCount > 0;
+}
+
+void GpuProfiler::beginPass(const char *name)
+{
+  Frame &frame = frames[current];
+  if (inPass || frame.passCount == MAX_PASSES)
+  {
+    return;
+  }
+  Queries &queries = frame.passes[frame.passCount++];
+  queries.name = name;
+  glBeginQuery(GL_TIME_ELAPSED, queries.time);
+  glBeginQuery(GL_PRIMITIVES_GENERATED, queries.primitives);
+  inPass = true;
+}
+
+void GpuProfiler::endPass()
+{
+  if (!inPass)
+  {
+    return;
+  }
+  glEndQuery(GL_PRIMITIVES_GENERATED);
+  glEndQuery(GL_TIME_ELAPSED);
+  inPass = false;
+}
+
+void GpuProfiler::collect(Frame &frame)
+{
+  static Metrics::Histogram &frameTime = Metrics::histogram("gpu frame ms");
+  static Metrics::Counter &dropped = Metrics::counter("gpu frames dropped");
+  frame.pending = false;
+
+  // results become available in the order the queries were issued, so the last one
+  // stands in for the whole frame. never wait on it, that would be the stall this avoids
+  GLuint available = 0;
+  glGetQueryObjectuiv(frame.passes[frame.passCount - 1].time, GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+  {
+    dropped.add();
+    return;
+  }
+
+  double totalMs = 0.0;
+  for (int i = 0; i < frame.passCount; i++)
+  {
+    const Queries &queries = frame.passes[i];
+    GLuint64 ns = 0;
+    GLuint primitives = 0;
+    glGetQueryObjectui64v(queries.time, GL_QUERY_RESULT, &ns);
+    glGetQueryObjectuiv(queries.primitives, GL_QUERY_RESULT, &primitives);
+
+    PassMetrics &metrics = metricsFor(queries.name);
+    const double ms = double(ns) / 1e6;
+    metrics.time->record(ms);
+    metrics.primitives->set(double(primitives));
+    totalMs += ms;
+  }
+  frameTime.record(totalMs);
+}
+
+GpuProfiler::PassMetrics &GpuProfiler::metricsFor(const char *name)
+{
+  // a handful of passes, a linear search on the pointer beats a registry lookup every frame
+  for (PassMetrics &metrics : passMetrics)
+  {
+    if (metrics.name == name)
+    {
+      return metrics;
+    }
+  }
+  const std::string prefix = std::string("gpu ") + name;
+  passMetrics.push_back(PassMetrics{name, &Metrics::histogram(prefix + " ms"), &Metrics::gauge(prefix + " primitives")});
+  return passMetrics.back();
+}
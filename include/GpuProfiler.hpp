@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <libs/glad/glad.h>
+#include "Metrics.hpp"
+
+/*
+    GPU time and primitives generated per render pass, without stalling the
+    CPU on the answer. Each pass brackets its draws with a GL_TIME_ELAPSED
+    and a GL_PRIMITIVES_GENERATED query. The queries for a frame sit in one
+    of FRAMES_IN_FLIGHT slots and are only read once the slot comes round
+    again, by which point the GPU has almost always finished them; a slot
+    that still isn't ready is dropped (and counted) rather than waited on.
+
+        gpu.beginFrame();
+        {
+            GpuProfiler::Pass pass(gpu, "chunks");
+            ...draws...
+        }
+        gpu.endFrame();
+
+    Results go to the "gpu <pass> ms" histograms, the "gpu <pass> primitives"
+    gauges and "gpu frame ms" for all passes together. Passes can't nest,
+    GL only allows one active query per target.
+*/
+class GpuProfiler
+{
+    public:
+    static constexpr int FRAMES_IN_FLIGHT = 4;
+    static constexpr int MAX_PASSES = 8;
+
+    GpuProfiler();
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // moves to the next slot, reading back what it held from FRAMES_IN_FLIGHT frames ago
+    void beginFrame();
+    void endFrame();
+
+    // name must outlive the profiler, string literals do. past MAX_PASSES a pass goes unmeasured
+    void beginPass(const char* name);
+    void endPass();
+
+    class Pass
+    {
+        public:
+        Pass(GpuProfiler& profiler, const char* name) : profiler(profiler) { profiler.beginPass(name); }
+        ~Pass() { profiler.endPass(); }
+
+        Pass(const Pass&) = delete;
+        Pass& operator=(const Pass&) = delete;
+
+        private:
+        GpuProfiler& profiler;
+    };
+
+    private:
+    struct Queries
+    {
+        const char* name = nullptr;
+        GLuint time = 0;
+        GLuint primitives = 0;
+    };
+
+    struct Frame
+    {
+        std::array<Queries, MAX_PASSES> passes;
+        int passCount = 0;
+        bool pending = false; // issued and not read back yet
+    };
+
+    struct PassMetrics
+    {
+        const char* name;
+        Metrics::Histogram* time;
+        Metrics::Gauge* primitives;
+    };
+
+    void collect(Frame& frame);
+    PassMetrics& metricsFor(const char* name);
+
+    std::array<Frame, FRAMES_IN_FLIGHT> frames;
+    int current = 0;
+    bool inPass = false;
+    std::vector<PassMetrics> passMetrics;
+};
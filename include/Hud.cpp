@@ -0,0 +1,157 @@
+#include "Hud.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include "scripts/Loader.h"
+
+namespace
+{
+  constexpr int GLYPH_W = 3, GLYPH_H = 5;
+  // a column between characters and a row between lines
+  constexpr int ADVANCE = GLYPH_W + 1, LINE_HEIGHT = GLYPH_H + 2;
+  constexpr int MARGIN = 4;
+
+  const glm::vec4 textColour(1.0f, 1.0f, 1.0f, 1.0f);
+  const glm::vec4 backgroundColour(0.0f, 0.0f, 0.0f, 0.55f);
+}
+
+Hud::Hud()
+    : shader(Loader::getPath("shaders/hud.vs"), Loader::getPath("shaders/hud.fs"))
+{
+  glGenVertexArrays(1, &VAO);
+  glGenBuffers(1, &VBO);
+  glBindVertexArray(VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void *)offsetof(HudVertex, position));
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void *)offsetof(HudVertex, colour));
+  glBindVertexArray(0);
+}
+
+Hud::~Hud()
+{
+  glDeleteVertexArrays(1, &VAO);
+  glDeleteBuffers(1, &VBO);
+}
+
+unsigned Hud::glyph(char c)
+{
+  // one octal digit per row, 4 is the left pixel and 1 the right
+  switch (std::toupper(static_cast<unsigned char>(c)))
+  {
+  case '0': return 075557;
+  case '1': return 026227;
+  case '2': return 071747;
+  case '3': return 071717;
+  case '4': return 055711;
+  case '5': return 074717;
+  case '6': return 074757;
+  case '7': return 071111;
+  case '8': return 075757;
+  case '9': return 075717;
+  case 'A': return 025755;
+  case 'B': return 065656;
+  case 'C': return 034443;
+  case 'D': return 065556;
+  case 'E': return 074647;
+  case 'F': return 074644;
+  case 'G': return 034553;
+  case 'H': return 055755;
+  case 'I': return 072227;
+  case 'J': return 011152;
+  case 'K': return 055655;
+  case 'L': return 044447;
+  case 'M': return 057755;
+  case 'N': return 065555;
+  case 'O': return 025552;
+  case 'P': return 065644;
+  case 'Q': return 025563;
+  case 'R': return 065655;
+  case 'S': return 034216;
+  case 'T': return 072222;
+  case 'U': return 055557;
+  case 'V': return 055552;
+  case 'W': return 055775;
+  case 'X': return 055255;
+  case 'Y': return 055222;
+  case 'Z': return 071247;
+  case '.': return 000002;
+  case ',': return 000024;
+  case ':': return 002020;
+  case '/': return 011244;
+  case '(': return 012221;
+  case ')': return 042224;
+  case '-': return 000700;
+  case '+': return 002720;
+  case '=': return 007070;
+  case '%': return 051245;
+  case '_': return 000007;
+  case '?': return 071202;
+  default: return 0;
+  }
+}
+
+void Hud::addRect(float x, float y, float w, float h, const glm::vec4 &colour)
+{
+  const HudVertex a{{x, y}, colour}, b{{x + w, y}, colour}, c{{x + w, y + h}, colour}, d{{x, y + h}, colour};
+  vertices.insert(vertices.end(), {a, b, c, a, c, d});
+}
+
+void Hud::draw(const std::vector<std::string> &lines, int screenWidth, int screenHeight)
+{
+  if (lines.empty())
+  {
+    return;
+  }
+  vertices.clear();
+
+  size_t widest = 0;
+  for (const std::string &line : lines)
+  {
+    widest = std::max(widest, line.size());
+  }
+  addRect(0.0f, 0.0f, float((MARGIN * 2 + int(widest) * ADVANCE) * SCALE), float((MARGIN * 2 + int(lines.size()) * LINE_HEIGHT) * SCALE),
+          backgroundColour);
+
+  for (size_t row = 0; row < lines.size(); row++)
+  {
+    const float top = float((MARGIN + int(row) * LINE_HEIGHT) * SCALE);
+    for (size_t col = 0; col < lines[row].size(); col++)
+    {
+      const unsigned bits = glyph(lines[row][col]);
+      const float left = float((MARGIN + int(col) * ADVANCE) * SCALE);
+      for (int py = 0; py < GLYPH_H; py++)
+      {
+        for (int px = 0; px < GLYPH_W; px++)
+        {
+          if (bits & (1u << ((GLYPH_H - 1 - py) * GLYPH_W + (GLYPH_W - 1 - px))))
+          {
+            addRect(left + float(px * SCALE), top + float(py * SCALE), float(SCALE), float(SCALE), textColour);
+          }
+        }
+      }
+    }
+  }
+
+  const GLboolean depth = glIsEnabled(GL_DEPTH_TEST), cull = glIsEnabled(GL_CULL_FACE), blend = glIsEnabled(GL_BLEND);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_CULL_FACE);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  shader.use();
+  shader.setVec2("screen", float(screenWidth), float(screenHeight));
+  glBindVertexArray(VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(HudVertex), vertices.data(), GL_STREAM_DRAW);
+  glDrawArrays(GL_TRIANGLES, 0, GLsizei(vertices.size()));
+  glBindVertexArray(0);
+
+  if (depth)
+    glEnable(GL_DEPTH_TEST);
+  if (cull)
+    glEnable(GL_CULL_FACE);
+  if (!blend)
+    glDisable(GL_BLEND);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <libs/glad/glad.h>
+#include <libs/glm/glm.hpp>
+#include "shader_m.h"
+
+/*
+    Text in the top left corner of the screen, for the metrics readout. No
+    font texture: every glyph is a 3x5 bitmap packed into 15 bits and each
+    set bit is drawn as a small quad, over a translucent box. Only the
+    characters the readouts use are in the table (digits, letters, a little
+    punctuation, lowercase shows as uppercase), anything else is a gap.
+
+    Everything is rebuilt and uploaded on each draw, a screenful of text is
+    a few thousand vertices.
+*/
+class Hud
+{
+    public:
+    // screen pixels per font pixel
+    static constexpr int SCALE = 2;
+
+    Hud();
+    ~Hud();
+
+    Hud(const Hud&) = delete;
+    Hud& operator=(const Hud&) = delete;
+
+    // lines from the top down. leaves depth testing, culling and blending as it found them
+    void draw(const std::vector<std::string>& lines, int screenWidth, int screenHeight);
+
+    private:
+    struct HudVertex
+    {
+        glm::vec2 position; // pixels from the top left
+        glm::vec4 colour;
+    };
+
+    void addRect(float x, float y, float w, float h, const glm::vec4& colour);
+    // 15 bits, top row first, leftmost pixel the highest bit of its row. 0 if we have no glyph
+    static unsigned glyph(char c);
+
+    Shader shader;
+    GLuint VAO = 0, VBO = 0;
+    std::vector<HudVertex> vertices;
+};
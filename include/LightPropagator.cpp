@@ -0,0 +1,401 @@
+#include "LightPropagator.hpp"
+#include "Chunk.hpp"
+#include "World.hpp"
+#include "Trace.hpp"
+
+namespace
+{
+  constexpr int W = WorldSettings::CHUNK_WIDTH;
+  constexpr int H = WorldSettings::CHUNK_HEIGHT;
+  constexpr int D = WorldSettings::CHUNK_DEPTH;
+
+  // same order as dirOffsets, -Y is the one sky light keeps its strength along
+  constexpr int kDirs[6][3] = {{0, 0, 1}, {0, 0, -1}, {0, 1, 0}, {0, -1, 0}, {1, 0, 0}, {-1, 0, 0}};
+  constexpr int kDown = 3;
+
+  uint8_t lightOf(const Chunk &chunk, int i, int channel)
+  {
+    const uint8_t cell = chunk.light[i].load(std::memory_order_relaxed);
+    return channel == LightPropagator::Sky ? cell >> 4 : cell & 0x0F;
+  }
+
+  // the writer is the only one changing the cell, so no read-modify-write is needed
+  void writeLight(std::atomic<uint8_t> &cell, int channel, uint8_t level)
+  {
+    const uint8_t old = cell.load(std::memory_order_relaxed);
+    cell.store(channel == LightPropagator::Sky ? uint8_t((old & 0x0F) | (level << 4)) : uint8_t((old & 0xF0) | level),
+               std::memory_order_relaxed);
+  }
+
+  // what a cell with `level` gives the neighbour in direction d
+  uint8_t spreadLevel(int channel, int d, uint8_t level)
+  {
+    return channel == LightPropagator::Sky && d == kDown && level == MAX_LIGHT ? MAX_LIGHT : uint8_t(level - 1);
+  }
+
+  // light sources are opaque but still shine into the cells around them
+  bool shines(BlockType type)
+  {
+    return !blocksLight(type) || blockEmission(type) > 0;
+  }
+
+  // a cell's own section, plus the one above or below when it sits on that boundary
+  uint16_t sectionsAround(int y)
+  {
+    const int section = y / WorldSettings::SECTION_HEIGHT, ly = y % WorldSettings::SECTION_HEIGHT;
+    uint16_t sections = uint16_t(1u << section);
+    if (ly == 0 && section > 0)
+    {
+      sections |= uint16_t(1u << (section - 1));
+    }
+    if (ly == WorldSettings::SECTION_HEIGHT - 1 && section < WorldSettings::SECTION_COUNT - 1)
+    {
+      sections |= uint16_t(1u << (section + 1));
+    }
+    return sections;
+  }
+}
+
+void LightPropagator::lightChunk(Chunk &chunk)
+{
+  TRACE_ZONE("light");
+  for (std::atomic<uint8_t> &cell : chunk.light)
+  {
+    cell.store(0, std::memory_order_relaxed);
+  }
+  std::vector<int> queue;
+
+  // only ever inside this chunk, the neighbours are joined up later by stitchCentre
+  auto spread = [&](int channel)
+  {
+    for (size_t head = 0; head < queue.size(); ++head)
+    {
+      const int i = queue[head];
+      const int x = i % W, y = (i / W) % H, z = i / (W * H);
+      const uint8_t level = lightOf(chunk, i, channel);
+      for (int d = 0; d < 6; ++d)
+      {
+        const int nx = x + kDirs[d][0], ny = y + kDirs[d][1], nz = z + kDirs[d][2];
+        if (nx < 0 || nx >= W || ny < 0 || ny >= H || nz < 0 || nz >= D)
+        {
+          continue;
+        }
+        const int n = Chunk::cellIndex(nx, ny, nz);
+        if (blocksLight(chunk.blockAt(n)))
+        {
+          continue;
+        }
+        const uint8_t next = spreadLevel(channel, d, level);
+        if (next > lightOf(chunk, n, channel))
+        {
+          writeLight(chunk.light[n], channel, next);
+          queue.push_back(n);
+        }
+      }
+    }
+    queue.clear();
+  };
+
+  // sky: straight down every column to the first block, tops[] is the lowest lit y
+  std::array<int, W * D> tops;
+  for (int z = 0; z < D; ++z)
+  {
+    for (int x = 0; x < W; ++x)
+    {
+      int y = H - 1;
+      for (; y >= 0 && !blocksLight(chunk.blockAt(Chunk::cellIndex(x, y, z))); --y)
+      {
+        writeLight(chunk.light[Chunk::cellIndex(x, y, z)], Sky, MAX_LIGHT);
+      }
+      tops[x + W * z] = y + 1;
+    }
+  }
+  // then sideways, from the lit cells next to a column that is still dark at that height
+  for (int z = 0; z < D; ++z)
+  {
+    for (int x = 0; x < W; ++x)
+    {
+      int lowest = tops[x + W * z];
+      for (int d : {0, 1, 4, 5})
+      {
+        const int nx = x + kDirs[d][0], nz = z + kDirs[d][2];
+        if (nx >= 0 && nx < W && nz >= 0 && nz < D)
+        {
+          lowest = std::max(lowest, tops[nx + W * nz]);
+        }
+      }
+      for (int y = tops[x + W * z]; y < lowest; ++y)
+      {
+        queue.push_back(Chunk::cellIndex(x, y, z));
+      }
+    }
+  }
+  spread(Sky);
+
+  for (int s = 0; s < WorldSettings::SECTION_COUNT; ++s)
+  {
+    if (chunk.sectionBlockCount(s) == 0)
+    {
+      continue;
+    }
+    for (int z = 0; z < D; ++z)
+    {
+      for (int y = s * WorldSettings::SECTION_HEIGHT; y < (s + 1) * WorldSettings::SECTION_HEIGHT; ++y)
+      {
+        for (int x = 0; x < W; ++x)
+        {
+          const int i = Chunk::cellIndex(x, y, z);
+          if (uint8_t emission = blockEmission(chunk.blockAt(i)))
+          {
+            writeLight(chunk.light[i], Block, emission);
+            queue.push_back(i);
+          }
+        }
+      }
+    }
+  }
+  spread(Block);
+}
+
+LightPropagator::LightPropagator(World &world, int cx, int cz)
+    : access(world), originX(cx - 1), originZ(cz - 1)
+{
+  for (int rz = 0; rz < 3; ++rz)
+  {
+    for (int rx = 0; rx < 3; ++rx)
+    {
+      Chunk *chunk = access.chunkAt(originX + rx, originZ + rz);
+      // a chunk still being generated is lit by its own worker and stitched later
+      region[rx + 3 * rz] = chunk != nullptr && chunk->generated.load() ? chunk : nullptr;
+    }
+  }
+}
+
+void LightPropagator::setLight(Chunk &chunk, int x, int y, int z, int channel, uint8_t level)
+{
+  const int lx = WorldAccessor::localCoord(x), lz = WorldAccessor::localCoord(z);
+  writeLight(chunk.light[Chunk::cellIndex(lx, y, lz)], channel, level);
+
+  // the faces that look into this cell belong to the blocks around it
+  const int rx = chunk.chunkX - originX, rz = chunk.chunkZ - originZ;
+  const uint16_t own = uint16_t(1u << (y / WorldSettings::SECTION_HEIGHT));
+  touchedSections[rx + 3 * rz] |= sectionsAround(y);
+  if (lx == 0 && rx > 0) touchedSections[rx - 1 + 3 * rz] |= own;
+  if (lx == W - 1 && rx < 2) touchedSections[rx + 1 + 3 * rz] |= own;
+  if (lz == 0 && rz > 0) touchedSections[rx + 3 * (rz - 1)] |= own;
+  if (lz == D - 1 && rz < 2) touchedSections[rx + 3 * (rz + 1)] |= own;
+}
+
+void LightPropagator::blockChanged(int x, int y, int z)
+{
+  Chunk *chunk = chunkFor(x, z);
+  if (chunk == nullptr || y < 0 || y >= H)
+  {
+    return;
+  }
+  const int i = Chunk::cellIndex(WorldAccessor::localCoord(x), y, WorldAccessor::localCoord(z));
+  const BlockType type = chunk->blockAt(i);
+
+  // whatever the cell held goes, along with everything that was lit through it
+  for (int channel : {Sky, Block})
+  {
+    if (uint8_t level = lightOf(*chunk, i, channel))
+    {
+      setLight(*chunk, x, y, z, channel, 0);
+      removeQueue[channel].push_back(Node{x, y, z, level});
+    }
+  }
+  if (uint8_t emission = blockEmission(type))
+  {
+    setLight(*chunk, x, y, z, Block, emission);
+    addQueue[Block].push_back(Node{x, y, z, emission});
+  }
+  if (blocksLight(type))
+  {
+    return;
+  }
+
+  // open now, so the cells around it shine in (the top layer sees the sky directly)
+  if (y == H - 1)
+  {
+    setLight(*chunk, x, y, z, Sky, MAX_LIGHT);
+    addQueue[Sky].push_back(Node{x, y, z, MAX_LIGHT});
+  }
+  for (int d = 0; d < 6; ++d)
+  {
+    const int nx = x + kDirs[d][0], ny = y + kDirs[d][1], nz = z + kDirs[d][2];
+    Chunk *next = ny >= 0 && ny < H ? chunkFor(nx, nz) : nullptr;
+    if (next == nullptr)
+    {
+      continue;
+    }
+    const int n = Chunk::cellIndex(WorldAccessor::localCoord(nx), ny, WorldAccessor::localCoord(nz));
+    if (!shines(next->blockAt(n)))
+    {
+      continue;
+    }
+    for (int channel : {Sky, Block})
+    {
+      if (uint8_t level = lightOf(*next, n, channel))
+      {
+        addQueue[channel].push_back(Node{nx, ny, nz, level});
+      }
+    }
+  }
+}
+
+void LightPropagator::queueIfBrighter(const Chunk &from, int x, int y, int z, const Chunk &to, int toIndex)
+{
+  const int i = Chunk::cellIndex(WorldAccessor::localCoord(x), y, WorldAccessor::localCoord(z));
+  if (!shines(from.blockAt(i)) || blocksLight(to.blockAt(toIndex)))
+  {
+    return;
+  }
+  for (int channel : {Sky, Block})
+  {
+    const uint8_t level = lightOf(from, i, channel);
+    if (level > 1 && level - 1 > lightOf(to, toIndex, channel))
+    {
+      addQueue[channel].push_back(Node{x, y, z, level});
+    }
+  }
+}
+
+void LightPropagator::stitchCentre()
+{
+  Chunk *centre = region[4];
+  if (centre == nullptr)
+  {
+    return;
+  }
+  const int ox = centre->chunkX * W, oz = centre->chunkZ * D;
+  for (int d : {0, 1, 4, 5})
+  {
+    const int dx = kDirs[d][0], dz = kDirs[d][2];
+    Chunk *next = region[(1 + dx) + 3 * (1 + dz)];
+    if (next == nullptr)
+    {
+      continue;
+    }
+    // k runs along the shared face, (ax, az) is our border column and (bx, bz) theirs
+    for (int k = 0; k < (dx != 0 ? D : W); ++k)
+    {
+      const int ax = dx != 0 ? (dx > 0 ? W - 1 : 0) : k;
+      const int az = dz != 0 ? (dz > 0 ? D - 1 : 0) : k;
+      const int bx = dx != 0 ? (dx > 0 ? 0 : W - 1) : k;
+      const int bz = dz != 0 ? (dz > 0 ? 0 : D - 1) : k;
+      for (int y = 0; y < H; ++y)
+      {
+        queueIfBrighter(*centre, ox + ax, y, oz + az, *next, Chunk::cellIndex(bx, y, bz));
+        queueIfBrighter(*next, ox + ax + dx, y, oz + az + dz, *centre, Chunk::cellIndex(ax, y, az));
+      }
+    }
+  }
+}
+
+void LightPropagator::runRemovals(int channel)
+{
+  std::vector<Node> &queue = removeQueue[channel];
+  for (size_t head = 0; head < queue.size(); ++head)
+  {
+    const Node node = queue[head];
+    for (int d = 0; d < 6; ++d)
+    {
+      const int nx = node.x + kDirs[d][0], ny = node.y + kDirs[d][1], nz = node.z + kDirs[d][2];
+      Chunk *chunk = ny >= 0 && ny < H ? chunkFor(nx, nz) : nullptr;
+      if (chunk == nullptr)
+      {
+        continue;
+      }
+      const int i = Chunk::cellIndex(WorldAccessor::localCoord(nx), ny, WorldAccessor::localCoord(nz));
+      const BlockType type = chunk->blockAt(i);
+      if (blocksLight(type))
+      {
+        // a light source next to the dark patch fills it back in
+        if (channel == Block && blockEmission(type) > 0)
+        {
+          addQueue[channel].push_back(Node{nx, ny, nz, blockEmission(type)});
+        }
+        continue;
+      }
+      const uint8_t level = lightOf(*chunk, i, channel);
+      if (level == 0)
+      {
+        continue;
+      }
+      // dimmer than what we removed (or sunlight falling through it) means it was lit through
+      // the removed cell. anything else has another source and spreads back in afterwards
+      if (level < node.level || (channel == Sky && d == kDown && node.level == MAX_LIGHT))
+      {
+        setLight(*chunk, nx, ny, nz, channel, 0);
+        queue.push_back(Node{nx, ny, nz, level});
+      }
+      else
+      {
+        addQueue[channel].push_back(Node{nx, ny, nz, level});
+      }
+    }
+  }
+  queue.clear();
+}
+
+void LightPropagator::runAdditions(int channel)
+{
+  std::vector<Node> &queue = addQueue[channel];
+  for (size_t head = 0; head < queue.size(); ++head)
+  {
+    const Node node = queue[head];
+    const Chunk *chunk = chunkFor(node.x, node.z);
+    if (chunk == nullptr)
+    {
+      continue;
+    }
+    // the level it has now, a removal may have run since it was queued
+    const uint8_t level = lightOf(*chunk, Chunk::cellIndex(WorldAccessor::localCoord(node.x), node.y, WorldAccessor::localCoord(node.z)), channel);
+    if (level <= 1)
+    {
+      continue;
+    }
+    for (int d = 0; d < 6; ++d)
+    {
+      const int nx = node.x + kDirs[d][0], ny = node.y + kDirs[d][1], nz = node.z + kDirs[d][2];
+      Chunk *next = ny >= 0 && ny < H ? chunkFor(nx, nz) : nullptr;
+      if (next == nullptr)
+      {
+        continue;
+      }
+      const int n = Chunk::cellIndex(WorldAccessor::localCoord(nx), ny, WorldAccessor::localCoord(nz));
+      if (blocksLight(next->blockAt(n)))
+      {
+        continue;
+      }
+      const uint8_t spread = spreadLevel(channel, d, level);
+      if (spread > lightOf(*next, n, channel))
+      {
+        setLight(*next, nx, ny, nz, channel, spread);
+        queue.push_back(Node{nx, ny, nz, spread});
+      }
+    }
+  }
+  queue.clear();
+}
+
+void LightPropagator::run()
+{
+  TRACE_ZONE("light propagate");
+  runRemovals(Sky);
+  runRemovals(Block);
+  runAdditions(Sky);
+  runAdditions(Block);
+}
+
+void LightPropagator::collectTouched(std::vector<std::pair<Chunk *, uint16_t>> &out) const
+{
+  for (int slot = 0; slot < 9; ++slot)
+  {
+    if (region[slot] != nullptr && touchedSections[slot] != 0)
+    {
+      out.emplace_back(region[slot], touchedSections[slot]);
+    }
+  }
+}
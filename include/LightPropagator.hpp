@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "VoxelTypes.hpp"
+#include "WorldAccessor.hpp"
+#include "WorldConfig.hpp"
+
+class Chunk;
+class World;
+
+/*
+    Sky light and block light, 4 bits each per voxel (Chunk::light), spread
+    by breadth-first flood fill. A step costs one level, except sky light
+    at full strength going straight down, which is how columns open to the
+    sky stay at 15 all the way to the ground.
+
+    A new chunk is lit on its own on the worker that generated it
+    (lightChunk). Light across its borders is joined up afterwards by a
+    propagator on the render thread's light pass (stitchCentre). Edits
+    queue a removal for the light the changed cell held and additions from
+    whatever now shines into it, and run() does the removals first and then
+    spreads light back in from the edge of the darkened area. Only that
+    area is touched.
+
+    Light never travels more than 15 blocks sideways, so everything an
+    edit or a stitch in one chunk can change lies in the 3x3 chunks around
+    it. A propagator only ever reads and writes those, and the world runs
+    propagators for chunks three apart at the same time.
+*/
+class LightPropagator
+{
+    public:
+    enum Channel { Sky = 0, Block = 1 };
+
+    // worker, before the chunk is marked generated: open columns get full sky light, light
+    // sources their emission, then both spread as far as they can inside the chunk
+    static void lightChunk(Chunk& chunk);
+
+    // works on the 3x3 chunks around (cx, cz), the ones that aren't generated are left alone
+    LightPropagator(World& world, int cx, int cz);
+
+    // the block at a world position has changed, queues the relight
+    void blockChanged(int x, int y, int z);
+    // queues light across the borders between the centre chunk and its side neighbours, both ways
+    void stitchCentre();
+    // removals first, then additions
+    void run();
+
+    // chunks and sections with a cell whose light changed, or a face next to one
+    void collectTouched(std::vector<std::pair<Chunk*, uint16_t>>& out) const;
+
+    private:
+    struct Node
+    {
+        int x, y, z;
+        uint8_t level;
+    };
+
+    // generated chunk of the region holding world column (x, z), nullptr outside it
+    Chunk* chunkFor(int x, int z) const
+    {
+        const int rx = WorldAccessor::chunkCoord(x) - originX, rz = WorldAccessor::chunkCoord(z) - originZ;
+        if (rx < 0 || rx > 2 || rz < 0 || rz > 2)
+        {
+            return nullptr;
+        }
+        return region[rx + 3 * rz];
+    }
+    // world position inside chunk, also records which sections need a remesh for it
+    void setLight(Chunk& chunk, int x, int y, int z, int channel, uint8_t level);
+    // queues the cell at world (x, y, z) in `from` if it would brighten its neighbour in `to`
+    void queueIfBrighter(const Chunk& from, int x, int y, int z, const Chunk& to, int toIndex);
+    void runRemovals(int channel);
+    void runAdditions(int channel);
+
+    WorldAccessor access;
+    // chunk coordinates of the region's -x -z corner
+    int originX, originZ;
+    std::array<Chunk*, 9> region{};
+    std::array<uint16_t, 9> touchedSections{};
+    std::vector<Node> removeQueue[2], addQueue[2];
+};
@@ -0,0 +1,179 @@
+#include "Log.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Log
+{
+  namespace
+  {
+    struct Record
+    {
+      int64_t ticks;
+      Level level;
+      std::string text;
+    };
+
+    // the owning thread appends, the writer swaps the whole vector out. the lock is only
+    // ever held for a push_back or a swap
+    struct ThreadBuffer
+    {
+      std::mutex mutex;
+      std::vector<Record> records;
+    };
+
+    const char *prefix(Level level)
+    {
+      switch (level)
+      {
+      case Level::Debug:
+        return "[debug] ";
+      case Level::Warn:
+        return "[warn] ";
+      case Level::Error:
+        return "[error] ";
+      default:
+        return "";
+      }
+    }
+
+    class Writer
+    {
+    public:
+      Writer() : thread([this]
+                        { run(); }) {}
+
+      ~Writer()
+      {
+        {
+          std::lock_guard<std::mutex> lock(wakeMutex);
+          stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+        drain();
+      }
+
+      ThreadBuffer &threadBuffer()
+      {
+        // shared so lines a thread logged just before exiting still get written
+        thread_local std::shared_ptr<ThreadBuffer> buffer;
+        if (!buffer)
+        {
+          buffer = std::make_shared<ThreadBuffer>();
+          std::lock_guard<std::mutex> lock(buffersMutex);
+          buffers.push_back(buffer);
+        }
+        return *buffer;
+      }
+
+      void nudge() { wake.notify_one(); }
+
+      void drain()
+      {
+        std::lock_guard<std::mutex> drainLock(drainMutex);
+        {
+          std::lock_guard<std::mutex> lock(buffersMutex);
+          for (const std::shared_ptr<ThreadBuffer> &buffer : buffers)
+          {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            batch.insert(batch.end(), std::make_move_iterator(buffer->records.begin()), std::make_move_iterator(buffer->records.end()));
+            buffer->records.clear();
+          }
+        }
+        const size_t lost = dropped.exchange(0);
+        if (batch.empty() && lost == 0)
+        {
+          return;
+        }
+        std::stable_sort(batch.begin(), batch.end(), [](const Record &a, const Record &b)
+                         { return a.ticks < b.ticks; });
+        for (const Record &record : batch)
+        {
+          std::fputs(prefix(record.level), stdout);
+          std::fwrite(record.text.data(), 1, record.text.size(), stdout);
+          std::fputc('\n', stdout);
+        }
+        if (lost != 0)
+        {
+          std::fprintf(stdout, "[warn] %zu log lines dropped, logging faster than they can be written\n", lost);
+        }
+        std::fflush(stdout);
+        batch.clear();
+      }
+
+      std::atomic<size_t> dropped{0};
+
+    private:
+      void run()
+      {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        while (!stopping)
+        {
+          wake.wait_for(lock, std::chrono::milliseconds(50));
+          lock.unlock();
+          drain();
+          lock.lock();
+        }
+      }
+
+      std::mutex buffersMutex;
+      std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+      // one drain at a time, flush() may run one alongside the thread
+      std::mutex drainMutex;
+      std::vector<Record> batch;
+
+      std::mutex wakeMutex;
+      std::condition_variable wake;
+      bool stopping = false;
+      std::thread thread;
+    };
+
+    Writer &writer()
+    {
+      static Writer instance;
+      return instance;
+    }
+  }
+
+  std::ostringstream &scratch()
+  {
+    thread_local std::ostringstream stream;
+    stream.str(std::string());
+    stream.clear();
+    return stream;
+  }
+
+  void write(Level level, std::string text)
+  {
+    Writer &out = writer();
+    ThreadBuffer &buffer = out.threadBuffer();
+    const int64_t ticks = std::chrono::steady_clock::now().time_since_epoch().count();
+    {
+      std::lock_guard<std::mutex> lock(buffer.mutex);
+      if (buffer.records.size() >= MAX_PENDING)
+      {
+        out.dropped++;
+        return;
+      }
+      buffer.records.push_back(Record{ticks, level, std::move(text)});
+    }
+    // errors go out straight away, anything else waits for the writer's next round
+    if (level == Level::Error)
+    {
+      out.nudge();
+    }
+  }
+
+  void flush()
+  {
+    writer().drain();
+  }
+}
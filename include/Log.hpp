@@ -0,0 +1,67 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+
+/*
+    Leveled logging that never waits on stdout. A log call formats its line
+    on the calling thread and appends it to that thread's own buffer. A
+    background thread collects every buffer a few times a second and writes
+    them out in time order with a single flush, so a worker or the render
+    loop never takes the stream's lock or sits in a flush.
+
+        LOG_INFO("loaded " << count << " chunks");
+
+    Levels below LOG_MIN_LEVEL (Debug 0, Info 1, Warn 2, Error 3; Info by
+    default) are compiled out, their arguments aren't even evaluated. A
+    thread that logs faster than the writer keeps up drops lines past
+    MAX_PENDING instead of growing without bound, the writer reports how
+    many.
+*/
+
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 1
+#endif
+
+namespace Log
+{
+    enum class Level : int { Debug = 0, Info = 1, Warn = 2, Error = 3 };
+
+    // lines a thread can have waiting for the writer
+    inline constexpr size_t MAX_PENDING = 8192;
+
+    // this thread's formatting stream, emptied
+    std::ostringstream& scratch();
+    void write(Level level, std::string text);
+    // writes everything logged so far before returning
+    void flush();
+}
+
+#define LOG_AT(level, expr)                                    \
+    do                                                         \
+    {                                                          \
+        std::ostringstream& logStream = Log::scratch();        \
+        logStream << expr;                                     \
+        Log::write(level, logStream.str());                    \
+    } while (0)
+
+#if LOG_MIN_LEVEL <= 0
+#define LOG_DEBUG(expr) LOG_AT(Log::Level::Debug, expr)
+#else
+#define LOG_DEBUG(expr) ((void)0)
+#endif
+#if LOG_MIN_LEVEL <= 1
+#define LOG_INFO(expr) LOG_AT(Log::Level::Info, expr)
+#else
+#define LOG_INFO(expr) ((void)0)
+#endif
+#if LOG_MIN_LEVEL <= 2
+#define LOG_WARN(expr) LOG_AT(Log::Level::Warn, expr)
+#else
+#define LOG_WARN(expr) ((void)0)
+#endif
+#if LOG_MIN_LEVEL <= 3
+#define LOG_ERROR(expr) LOG_AT(Log::Level::Error, expr)
+#else
+#define LOG_ERROR(expr) ((void)0)
+#endif
@@ -9,48 +9,117 @@
 #include "shader_m.h"
 #include "Mesh.hpp"
 
+// no GL here, a chunk can be built and meshed without a context (the headless bench does).
+// the buffers are made on the first upload
 Mesh::Mesh()
 {
-    setupMesh();
 }
 Mesh::~Mesh()
 {
     if (VAO)
     {
         glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
-        glDeleteBuffers(1, &EBO);
+    }
+    for (Buffers *b : {&live, &pending})
+    {
+        if (b->VBO)
+        {
+            glDeleteBuffers(1, &b->VBO);
+            glDeleteBuffers(1, &b->EBO);
+        }
+    }
+    if (retired)
+    {
+        glDeleteSync(retired);
     }
 }
 // Upload new vertex/index data to the GPU
 void Mesh::setData(std::vector<Vertex> &verts,
-                   std::vector<uint32_t> &idx)
+                   std::vector<uint32_t> &idx, Slot slot)
 {
     vertices.swap(verts);
     indices.swap(idx);
-    indexCount = (GLsizei)indices.size();
-    // Bind and update buffers
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER,
-                 vertices.size() * sizeof(Vertex),
-                 vertices.data(),
-                 GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 indices.size() * sizeof(uint32_t),
-                 indices.data(),
-                 GL_STATIC_DRAW);
+    Buffers &b = prepare(slot);
+    b.indexCount = (GLsizei)indices.size();
+    // through the copy target so the VAO's element buffer binding is left alone
+    const size_t vertexBytes = vertices.size() * sizeof(Vertex);
+    fit(b.VBO, b.vertexCapacity, vertexBytes);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, 0, vertexBytes, vertices.data());
+    const size_t indexBytes = indices.size() * sizeof(uint32_t);
+    fit(b.EBO, b.indexCapacity, indexBytes);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, 0, indexBytes, indices.data());
+}
+void Mesh::copyFrom(GLuint staging, size_t offset, uint32_t vertexCount, uint32_t indexCount, Slot slot)
+{
+    // whatever the CPU copy held is stale now
+    vertices.clear();
+    indices.clear();
+    Buffers &b = prepare(slot);
+    b.indexCount = (GLsizei)indexCount;
+    const size_t vertexBytes = size_t(vertexCount) * sizeof(Vertex);
+    const size_t indexBytes = size_t(indexCount) * sizeof(uint32_t);
+    glBindBuffer(GL_COPY_READ_BUFFER, staging);
+    fit(b.VBO, b.vertexCapacity, vertexBytes);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, vertexBytes);
+    fit(b.EBO, b.indexCapacity, indexBytes);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset + vertexBytes, 0, indexBytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+void Mesh::publish()
+{
+    std::swap(live, pending);
+    if (VAO == 0)
+    {
+        glGenVertexArrays(1, &VAO);
+    }
+    // binding them again here is also what makes the other context's writes show up in this one
+    attachBuffers();
+    if (pending.VBO)
+    {
+        // the next Pending write waits on this instead of racing the draws still queued with them
+        retired = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+Mesh::Buffers &Mesh::prepare(Slot slot)
+{
+    if (slot == Slot::Live)
+    {
+        if (VAO == 0)
+        {
+            setupMesh();
+        }
+        return live;
+    }
+    // buffer names are shared between the contexts, a VAO isn't so it stays with the render thread
+    if (pending.VBO == 0)
+    {
+        glGenBuffers(1, &pending.VBO);
+        glGenBuffers(1, &pending.EBO);
+    }
+    if (retired)
+    {
+        // a wait on the GPU's side, this thread carries on queueing
+        glWaitSync(retired, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(retired);
+        retired = nullptr;
+    }
+    return pending;
 }
-void Mesh::draw(Shader &shader, GLuint &atlasText)
+void Mesh::fit(GLuint buffer, size_t &capacity, size_t bytes)
+{
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    if (bytes <= capacity && bytes >= capacity / 4)
+    {
+        return;
+    }
+    // some headroom, edits tend to add a few faces at a time
+    capacity = bytes + bytes / 4;
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+}
+void Mesh::draw()
 {
-    glBindTexture(GL_TEXTURE_2D, atlasText);
-    glActiveTexture(GL_TEXTURE0);
-    shader.use();
-    // shader.setInt("atlasTex", 0);
     glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    glDrawElements(GL_TRIANGLES, live.indexCount, GL_UNSIGNED_INT, 0);
 }
 // GPU handles
 GLuint VAO = 0, VBO = 0, EBO = 0;
@@ -65,12 +134,15 @@ void Mesh::setupMesh()
      * the chunk may not be drawn for sometime.
      */
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &live.VBO);
+    glGenBuffers(1, &live.EBO);
+    attachBuffers();
+}
+void Mesh::attachBuffers()
+{
     glBindVertexArray(VAO);
-    // Reserve empty buffers
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBindBuffer(GL_ARRAY_BUFFER, live.VBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, live.EBO);
     // Position
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Position));
@@ -80,5 +152,11 @@ void Mesh::setupMesh()
     // TexCoords
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, TexCoords));
+    // Sky and block light
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Light));
+    // Ambient occlusion
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Occlusion));
     glBindVertexArray(0);
 }
@@ -8,19 +8,48 @@
 class Mesh
 {
     public:
+    // Live is what draw() uses, written on the render thread. Pending is a second pair of buffers an
+    // upload thread with its own (shared) context fills while Live is still being drawn, publish()
+    // then swaps them over
+    enum class Slot { Live, Pending };
+
     Mesh();
     ~Mesh();
 
-    void setData(std::vector<Vertex>& verts, std::vector<uint32_t>& idx);
-    void draw(Shader& shader, GLuint& atlasText);
+    void setData(std::vector<Vertex>& verts, std::vector<uint32_t>& idx, Slot slot = Slot::Live);
+    // same thing from a staging buffer: vertexCount vertices at offset, the indices right after them.
+    // the copy runs on the GPU, nothing is read back here
+    void copyFrom(GLuint staging, size_t offset, uint32_t vertexCount, uint32_t indexCount, Slot slot = Slot::Live);
+    // render thread, once the upload thread's fence for the Pending data has signalled
+    void publish();
+    // binds the VAO and issues the draw, shader and texture state is the caller's job
+    void draw();
+    GLsizei getIndexCount() const { return live.indexCount; }
 
     private:
+    struct Buffers
+    {
+        GLuint VBO = 0, EBO = 0;
+        // bytes of storage behind VBO and EBO
+        size_t vertexCapacity = 0, indexCapacity = 0;
+        GLsizei indexCount = 0;
+    };
+
     void setupMesh();
+    // points the VAO's attributes and element buffer at the live buffers
+    void attachBuffers();
+    // the buffers a write to slot goes to, made (and for Pending, waited on) first
+    Buffers& prepare(Slot slot);
+    // grows (or shrinks a lot) the buffer's storage to hold bytes, a remesh of about the same size
+    // reuses what is there. leaves the buffer bound to GL_COPY_WRITE_BUFFER
+    static void fit(GLuint buffer, size_t& capacity, size_t bytes);
     // GPU handles
-    GLuint VAO = 0, VBO = 0, EBO = 0;
-    GLsizei indexCount = 0;
+    GLuint VAO = 0;
+    Buffers live, pending;
+    // put down when publish() retired the buffers now in pending, the GPU may still be drawing from them
+    GLsync retired = nullptr;
 
     // CPU-side cache (optional)
     std::vector<Vertex>   vertices;
     std::vector<uint32_t> indices;
-};
\ No newline at end of file
+};
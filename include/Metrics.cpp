@@ -0,0 +1,356 @@
+#include "Metrics.hpp"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace Metrics
+{
+  void Histogram::record(double ms)
+  {
+    const uint64_t us = ms <= 0.0 ? 0 : uint64_t(ms * 1000.0 + 0.5);
+    counts[bucketFor(us)].fetch_add(1, std::memory_order_relaxed);
+    sumUs.fetch_add(us, std::memory_order_relaxed);
+    uint64_t seen = maxUs.load(std::memory_order_relaxed);
+    while (us > seen && !maxUs.compare_exchange_weak(seen, us, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  int Histogram::bucketFor(uint64_t us)
+  {
+    if (us < uint64_t(SUB_BUCKETS))
+    {
+      return int(us);
+    }
+    // keep the top SUB_BITS bits, the bucket is which power of two plus which of its steps
+    int shift = std::bit_width(us) - SUB_BITS;
+    if (shift > MAX_SHIFT)
+    {
+      return BUCKETS - 1;
+    }
+    return shift * (SUB_BUCKETS / 2) + int(us >> shift);
+  }
+
+  double Histogram::bucketValue(int bucket)
+  {
+    if (bucket < SUB_BUCKETS)
+    {
+      return double(bucket);
+    }
+    const int shift = bucket / (SUB_BUCKETS / 2) - 1;
+    const uint64_t step = uint64_t(bucket - shift * (SUB_BUCKETS / 2));
+    return double(step << shift) + double(uint64_t(1) << shift) * 0.5;
+  }
+
+  Histogram::Summary Histogram::takeSummary()
+  {
+    // exchanged one at a time, a record() landing halfway through is split across two intervals
+    // which only ever moves one sample
+    std::array<uint32_t, BUCKETS> taken;
+    uint64_t n = 0;
+    for (int i = 0; i < BUCKETS; i++)
+    {
+      taken[i] = counts[i].exchange(0, std::memory_order_relaxed);
+      n += taken[i];
+    }
+    const uint64_t sum = sumUs.exchange(0, std::memory_order_relaxed);
+    const uint64_t max = maxUs.exchange(0, std::memory_order_relaxed);
+
+    Summary summary;
+    summary.count = n;
+    if (n == 0)
+    {
+      return summary;
+    }
+    summary.mean = double(sum) / double(n) / 1000.0;
+    summary.max = double(max) / 1000.0;
+
+    const uint64_t ranks[3] = {(n * 50 + 99) / 100, (n * 90 + 99) / 100, (n * 99 + 99) / 100};
+    double *values[3] = {&summary.p50, &summary.p90, &summary.p99};
+    uint64_t seen = 0;
+    int next = 0;
+    for (int i = 0; i < BUCKETS && next < 3; i++)
+    {
+      seen += taken[i];
+      while (next < 3 && seen >= std::max<uint64_t>(ranks[next], 1))
+      {
+        // a bucket's middle can sit past the largest value actually seen
+        *values[next] = std::min(bucketValue(i), double(max)) / 1000.0;
+        next++;
+      }
+    }
+    return summary;
+  }
+
+  namespace
+  {
+    struct Entry
+    {
+      std::string name;
+      Kind kind;
+      std::unique_ptr<Counter> counter;
+      std::unique_ptr<Gauge> gauge;
+      std::unique_ptr<Histogram> histogram;
+      int64_t lastTotal = 0;
+    };
+
+    struct Registry
+    {
+      std::mutex mutex;
+      // entries never move or go away, references handed out stay good
+      std::vector<std::unique_ptr<Entry>> entries;
+      std::map<std::string, Entry *> byName;
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      std::chrono::steady_clock::time_point lastSample = start;
+      Snapshot last;
+    };
+
+    Registry &registry()
+    {
+      static Registry instance;
+      return instance;
+    }
+
+    Entry &lookup(const std::string &name, Kind kind)
+    {
+      Registry &reg = registry();
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      auto found = reg.byName.find(name);
+      if (found != reg.byName.end())
+      {
+        return *found->second;
+      }
+      auto entry = std::make_unique<Entry>();
+      entry->name = name;
+      entry->kind = kind;
+      switch (kind)
+      {
+      case Kind::Counter:
+        entry->counter = std::make_unique<Counter>();
+        break;
+      case Kind::Gauge:
+        entry->gauge = std::make_unique<Gauge>();
+        break;
+      case Kind::Histogram:
+        entry->histogram = std::make_unique<Histogram>();
+        break;
+      }
+      Entry *raw = entry.get();
+      reg.entries.push_back(std::move(entry));
+      reg.byName[name] = raw;
+      return *raw;
+    }
+
+    const char *kindName(Kind kind)
+    {
+      switch (kind)
+      {
+      case Kind::Counter:
+        return "counter";
+      case Kind::Gauge:
+        return "gauge";
+      default:
+        return "histogram";
+      }
+    }
+
+    // metric names are ours, but keep the CSV and JSON well formed whatever they hold
+    std::string csvField(const std::string &text)
+    {
+      std::string out = "\"";
+      for (char c : text)
+      {
+        out += c == '"' ? std::string("\"\"") : std::string(1, c);
+      }
+      return out + "\"";
+    }
+
+    std::string jsonString(const std::string &text)
+    {
+      std::string out = "\"";
+      for (char c : text)
+      {
+        if (c == '"' || c == '\\')
+        {
+          out += '\\';
+        }
+        out += c;
+      }
+      return out + "\"";
+    }
+  }
+
+  // asking for a name with another kind than it was registered as is a bug, it gets a fresh
+  // metric of the right kind that nothing else sees rather than a crash
+  Counter &counter(const std::string &name)
+  {
+    Entry &entry = lookup(name, Kind::Counter);
+    if (!entry.counter)
+    {
+      return *lookup(name + " (counter)", Kind::Counter).counter;
+    }
+    return *entry.counter;
+  }
+
+  Gauge &gauge(const std::string &name)
+  {
+    Entry &entry = lookup(name, Kind::Gauge);
+    if (!entry.gauge)
+    {
+      return *lookup(name + " (gauge)", Kind::Gauge).gauge;
+    }
+    return *entry.gauge;
+  }
+
+  Histogram &histogram(const std::string &name)
+  {
+    Entry &entry = lookup(name, Kind::Histogram);
+    if (!entry.histogram)
+    {
+      return *lookup(name + " (histogram)", Kind::Histogram).histogram;
+    }
+    return *entry.histogram;
+  }
+
+  const Snapshot &sample()
+  {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    const auto now = std::chrono::steady_clock::now();
+    const double interval = std::chrono::duration<double>(now - reg.lastSample).count();
+    reg.lastSample = now;
+
+    Snapshot &snapshot = reg.last;
+    snapshot.time = std::chrono::duration<double>(now - reg.start).count();
+    snapshot.interval = interval;
+    snapshot.rows.clear();
+    for (const std::unique_ptr<Entry> &entry : reg.entries)
+    {
+      Row row;
+      row.name = entry->name;
+      row.kind = entry->kind;
+      switch (entry->kind)
+      {
+      case Kind::Counter:
+      {
+        const int64_t total = entry->counter->total();
+        row.total = double(total);
+        row.rate = interval > 0.0 ? double(total - entry->lastTotal) / interval : 0.0;
+        entry->lastTotal = total;
+        break;
+      }
+      case Kind::Gauge:
+        row.value = entry->gauge->get();
+        break;
+      case Kind::Histogram:
+        row.latency = entry->histogram->takeSummary();
+        break;
+      }
+      snapshot.rows.push_back(std::move(row));
+    }
+    return snapshot;
+  }
+
+  const Snapshot &lastSnapshot()
+  {
+    return registry().last;
+  }
+
+  const Row *find(const Snapshot &snapshot, const std::string &name)
+  {
+    for (const Row &row : snapshot.rows)
+    {
+      if (row.name == name)
+      {
+        return &row;
+      }
+    }
+    return nullptr;
+  }
+
+  std::vector<std::string> describe(const Snapshot &snapshot)
+  {
+    std::vector<std::string> lines;
+    char line[160];
+    for (const Row &row : snapshot.rows)
+    {
+      switch (row.kind)
+      {
+      case Kind::Counter:
+        std::snprintf(line, sizeof(line), "%s %.0f/s (%.0f)", row.name.c_str(), row.rate, row.total);
+        break;
+      case Kind::Gauge:
+        std::snprintf(line, sizeof(line), "%s %.0f", row.name.c_str(), row.value);
+        break;
+      case Kind::Histogram:
+        std::snprintf(line, sizeof(line), "%s p50 %.2f p99 %.2f max %.2f (%llu)", row.name.c_str(), row.latency.p50,
+                      row.latency.p99, row.latency.max, (unsigned long long)row.latency.count);
+        break;
+      }
+      lines.push_back(line);
+    }
+    return lines;
+  }
+
+  bool appendCsv(const Snapshot &snapshot, const std::string &path)
+  {
+    const bool fresh = !std::ifstream(path).good();
+    std::ofstream out(path, std::ios::app);
+    if (!out)
+    {
+      return false;
+    }
+    if (fresh)
+    {
+      out << "time,name,kind,total,rate,value,count,mean,p50,p90,p99,max\n";
+    }
+    out << std::fixed << std::setprecision(3);
+    for (const Row &row : snapshot.rows)
+    {
+      out << snapshot.time << ',' << csvField(row.name) << ',' << kindName(row.kind) << ','
+          << row.total << ',' << row.rate << ',' << row.value << ',' << row.latency.count << ','
+          << row.latency.mean << ',' << row.latency.p50 << ',' << row.latency.p90 << ','
+          << row.latency.p99 << ',' << row.latency.max << '\n';
+    }
+    return bool(out);
+  }
+
+  bool writeJson(const Snapshot &snapshot, const std::string &path)
+  {
+    std::ofstream out(path);
+    if (!out)
+    {
+      return false;
+    }
+    out << std::fixed << std::setprecision(3);
+    out << "{\"time\":" << snapshot.time << ",\"interval\":" << snapshot.interval << ",\"metrics\":[\n";
+    for (size_t i = 0; i < snapshot.rows.size(); i++)
+    {
+      const Row &row = snapshot.rows[i];
+      out << "{\"name\":" << jsonString(row.name) << ",\"kind\":\"" << kindName(row.kind) << "\"";
+      switch (row.kind)
+      {
+      case Kind::Counter:
+        out << ",\"total\":" << row.total << ",\"rate\":" << row.rate;
+        break;
+      case Kind::Gauge:
+        out << ",\"value\":" << row.value;
+        break;
+      case Kind::Histogram:
+        out << ",\"count\":" << row.latency.count << ",\"mean\":" << row.latency.mean << ",\"p50\":" << row.latency.p50
+            << ",\"p90\":" << row.latency.p90 << ",\"p99\":" << row.latency.p99 << ",\"max\":" << row.latency.max;
+        break;
+      }
+      out << (i + 1 < snapshot.rows.size() ? "},\n" : "}\n");
+    }
+    out << "]}\n";
+    return bool(out);
+  }
+}
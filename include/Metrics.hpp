@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+    Named counters, gauges and latency histograms that any thread can feed
+    and the render thread reads back once a second.
+
+        static Metrics::Histogram& meshTime = Metrics::histogram("mesh ms");
+        meshTime.record(ms);
+
+    Lookups take a lock, so callers keep the reference (a function static is
+    the usual way). Updates are lock-free atomics.
+
+    Histograms bucket like an HDR histogram: every power of two is split into
+    SUB_BUCKETS linear steps, so any value is held to within ~3% from
+    microseconds up to hours in ~2KB. sample() turns the last interval into a
+    Snapshot (counter rates, gauge values, histogram percentiles) and starts
+    the next interval, which is what the HUD and the CSV/JSON dumps show.
+*/
+namespace Metrics
+{
+    // adds up, shown as a total and a per-second rate
+    class Counter
+    {
+        public:
+        void add(int64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+        int64_t total() const { return value.load(std::memory_order_relaxed); }
+
+        private:
+        std::atomic<int64_t> value{0};
+    };
+
+    // the last value set
+    class Gauge
+    {
+        public:
+        void set(double v) { value.store(v, std::memory_order_relaxed); }
+        double get() const { return value.load(std::memory_order_relaxed); }
+
+        private:
+        std::atomic<double> value{0.0};
+    };
+
+    // milliseconds in, kept as microseconds
+    class Histogram
+    {
+        public:
+        static constexpr int SUB_BITS = 5;
+        static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+        static constexpr int MAX_SHIFT = 32;
+        static constexpr int BUCKETS = MAX_SHIFT * (SUB_BUCKETS / 2) + SUB_BUCKETS;
+
+        struct Summary
+        {
+            uint64_t count = 0;
+            double mean = 0.0, p50 = 0.0, p90 = 0.0, p99 = 0.0, max = 0.0;
+        };
+
+        void record(double ms);
+        // everything since the last call, and starts over
+        Summary takeSummary();
+
+        private:
+        static int bucketFor(uint64_t us);
+        // middle of what the bucket holds, in microseconds
+        static double bucketValue(int bucket);
+
+        std::array<std::atomic<uint32_t>, BUCKETS> counts{};
+        std::atomic<uint64_t> sumUs{0};
+        std::atomic<uint64_t> maxUs{0};
+    };
+
+    Counter& counter(const std::string& name);
+    Gauge& gauge(const std::string& name);
+    Histogram& histogram(const std::string& name);
+
+    enum class Kind { Counter, Gauge, Histogram };
+
+    struct Row
+    {
+        std::string name;
+        Kind kind;
+        // counter: total and per second. gauge: value. histogram: see Histogram::Summary
+        double total = 0.0, rate = 0.0, value = 0.0;
+        Histogram::Summary latency;
+    };
+
+    struct Snapshot
+    {
+        double time = 0.0;     // seconds since the first sample
+        double interval = 0.0; // seconds this snapshot covers
+        std::vector<Row> rows; // registration order
+    };
+
+    // render thread, once per interval
+    const Snapshot& sample();
+    const Snapshot& lastSnapshot();
+    // nullptr if nothing by that name was sampled
+    const Row* find(const Snapshot& snapshot, const std::string& name);
+    // one line per metric, for the HUD and the log
+    std::vector<std::string> describe(const Snapshot& snapshot);
+    // appends the snapshot's rows to a CSV file (a header first if it is new), false if it can't be written
+    bool appendCsv(const Snapshot& snapshot, const std::string& path);
+    // replaces the file with the snapshot as JSON
+    bool writeJson(const Snapshot& snapshot, const std::string& path);
+}
@@ -0,0 +1,352 @@
+#include "OcclusionCuller.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+  // anything closer than this to the eye is treated as crossing the near plane
+  constexpr float kNearW = 0.1f;
+  // below this many triangles waking the band threads costs more than it saves
+  constexpr size_t kMinParallelTriangles = 64;
+
+  // 4-wide helpers so the raster loop is written once for SSE, NEON and plain C++.
+  // masks are all-ones / all-zeros lanes stored in a float vector
+#if defined(__SSE2__)
+  using vfloat = __m128;
+  inline vfloat vset(float a) { return _mm_set1_ps(a); }
+  inline vfloat vlanes() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+  inline vfloat vload(const float *p) { return _mm_loadu_ps(p); }
+  inline void vstore(float *p, vfloat v) { _mm_storeu_ps(p, v); }
+  inline vfloat vadd(vfloat a, vfloat b) { return _mm_add_ps(a, b); }
+  inline vfloat vmul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+  inline vfloat vmax(vfloat a, vfloat b) { return _mm_max_ps(a, b); }
+  inline vfloat vgt(vfloat a, vfloat b) { return _mm_cmpgt_ps(a, b); }
+  inline vfloat vge(vfloat a, vfloat b) { return _mm_cmpge_ps(a, b); }
+  inline vfloat vle(vfloat a, vfloat b) { return _mm_cmple_ps(a, b); }
+  inline vfloat vand(vfloat a, vfloat b) { return _mm_and_ps(a, b); }
+  inline vfloat vselect(vfloat mask, vfloat a, vfloat b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+  inline bool vany(vfloat mask) { return _mm_movemask_ps(mask) != 0; }
+#elif defined(__ARM_NEON)
+  using vfloat = float32x4_t;
+  inline vfloat vset(float a) { return vdupq_n_f32(a); }
+  inline vfloat vlanes() { const float l[4] = {0.0f, 1.0f, 2.0f, 3.0f}; return vld1q_f32(l); }
+  inline vfloat vload(const float *p) { return vld1q_f32(p); }
+  inline void vstore(float *p, vfloat v) { vst1q_f32(p, v); }
+  inline vfloat vadd(vfloat a, vfloat b) { return vaddq_f32(a, b); }
+  inline vfloat vmul(vfloat a, vfloat b) { return vmulq_f32(a, b); }
+  inline vfloat vmax(vfloat a, vfloat b) { return vmaxq_f32(a, b); }
+  inline vfloat vgt(vfloat a, vfloat b) { return vreinterpretq_f32_u32(vcgtq_f32(a, b)); }
+  inline vfloat vge(vfloat a, vfloat b) { return vreinterpretq_f32_u32(vcgeq_f32(a, b)); }
+  inline vfloat vle(vfloat a, vfloat b) { return vreinterpretq_f32_u32(vcleq_f32(a, b)); }
+  inline vfloat vand(vfloat a, vfloat b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+  inline vfloat vselect(vfloat mask, vfloat a, vfloat b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+  inline bool vany(vfloat mask) { return vmaxvq_u32(vreinterpretq_u32_f32(mask)) != 0; }
+#else
+  // scalar fallback: a mask lane is 1.0f for true and 0.0f for false
+  struct vfloat
+  {
+    float f[4];
+  };
+  inline vfloat vset(float a) { return {{a, a, a, a}}; }
+  inline vfloat vlanes() { return {{0.0f, 1.0f, 2.0f, 3.0f}}; }
+  inline vfloat vload(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+  inline void vstore(float *p, vfloat v) { std::copy(v.f, v.f + 4, p); }
+  template <class Op>
+  inline vfloat vmap(vfloat a, vfloat b, Op op)
+  {
+    return {{op(a.f[0], b.f[0]), op(a.f[1], b.f[1]), op(a.f[2], b.f[2]), op(a.f[3], b.f[3])}};
+  }
+  inline vfloat vadd(vfloat a, vfloat b) { return vmap(a, b, [](float x, float y) { return x + y; }); }
+  inline vfloat vmul(vfloat a, vfloat b) { return vmap(a, b, [](float x, float y) { return x * y; }); }
+  inline vfloat vmax(vfloat a, vfloat b) { return vmap(a, b, [](float x, float y) { return std::max(x, y); }); }
+  inline vfloat vgt(vfloat a, vfloat b) { return vmap(a, b, [](float x, float y) { return x > y ? 1.0f : 0.0f; }); }
+  inline vfloat vge(vfloat a, vfloat b) { return vmap(a, b, [](float x, float y) { return x >= y ? 1.0f : 0.0f; }); }
+  inline vfloat vle(vfloat a, vfloat b) { return vmap(a, b, [](float x, float y) { return x <= y ? 1.0f : 0.0f; }); }
+  inline vfloat vand(vfloat a, vfloat b) { return vmul(a, b); }
+  inline vfloat vselect(vfloat mask, vfloat a, vfloat b)
+  {
+    return {{mask.f[0] != 0.0f ? a.f[0] : b.f[0], mask.f[1] != 0.0f ? a.f[1] : b.f[1],
+             mask.f[2] != 0.0f ? a.f[2] : b.f[2], mask.f[3] != 0.0f ? a.f[3] : b.f[3]}};
+  }
+  inline bool vany(vfloat mask) { return mask.f[0] != 0.0f || mask.f[1] != 0.0f || mask.f[2] != 0.0f || mask.f[3] != 0.0f; }
+#endif
+}
+
+OcclusionCuller::OcclusionCuller(unsigned int threadCount)
+    : depth(WIDTH * HEIGHT, 0.0f), bandCount(int(std::max(1u, threadCount)))
+{
+  for (int band = 1; band < bandCount; ++band)
+  {
+    workers.emplace_back(&OcclusionCuller::bandWorker, this, band);
+  }
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+  {
+    std::lock_guard<std::mutex> lock(m);
+    stopping = true;
+  }
+  startCv.notify_all();
+  for (auto &t : workers)
+  {
+    t.join();
+  }
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4 &newViewProjection, const glm::vec3 &newCameraPos)
+{
+  viewProjection = newViewProjection;
+  cameraPos = newCameraPos;
+  triangles.clear();
+  std::fill(depth.begin(), depth.end(), 0.0f);
+}
+
+void OcclusionCuller::addOccluder(const glm::vec3 &vmin, const glm::vec3 &vmax)
+{
+  // a face can only be seen if the camera is on its outer side, so at most 3 are kept
+  const glm::vec3 &c = cameraPos;
+  if (c.x < vmin.x)
+    addQuad({vmin.x, vmin.y, vmin.z}, {vmin.x, vmax.y, vmin.z}, {vmin.x, vmax.y, vmax.z}, {vmin.x, vmin.y, vmax.z});
+  else if (c.x > vmax.x)
+    addQuad({vmax.x, vmin.y, vmin.z}, {vmax.x, vmax.y, vmin.z}, {vmax.x, vmax.y, vmax.z}, {vmax.x, vmin.y, vmax.z});
+  if (c.y < vmin.y)
+    addQuad({vmin.x, vmin.y, vmin.z}, {vmax.x, vmin.y, vmin.z}, {vmax.x, vmin.y, vmax.z}, {vmin.x, vmin.y, vmax.z});
+  else if (c.y > vmax.y)
+    addQuad({vmin.x, vmax.y, vmin.z}, {vmax.x, vmax.y, vmin.z}, {vmax.x, vmax.y, vmax.z}, {vmin.x, vmax.y, vmax.z});
+  if (c.z < vmin.z)
+    addQuad({vmin.x, vmin.y, vmin.z}, {vmax.x, vmin.y, vmin.z}, {vmax.x, vmax.y, vmin.z}, {vmin.x, vmax.y, vmin.z});
+  else if (c.z > vmax.z)
+    addQuad({vmin.x, vmin.y, vmax.z}, {vmax.x, vmin.y, vmax.z}, {vmax.x, vmax.y, vmax.z}, {vmin.x, vmax.y, vmax.z});
+}
+
+void OcclusionCuller::addQuad(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, const glm::vec3 &d)
+{
+  glm::vec4 ca = viewProjection * glm::vec4(a, 1.0f);
+  glm::vec4 cb = viewProjection * glm::vec4(b, 1.0f);
+  glm::vec4 cc = viewProjection * glm::vec4(c, 1.0f);
+  glm::vec4 cd = viewProjection * glm::vec4(d, 1.0f);
+  addTriangle(ca, cb, cc);
+  addTriangle(ca, cc, cd);
+}
+
+void OcclusionCuller::addTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c)
+{
+  // no near clipping: a triangle that pokes through the near plane is just dropped,
+  // which can only make us draw more, never less
+  if (a.w < kNearW || b.w < kNearW || c.w < kNearW)
+  {
+    return;
+  }
+
+  auto toScreen = [](const glm::vec4 &p)
+  {
+    float invW = 1.0f / p.w;
+    return glm::vec3((p.x * invW * 0.5f + 0.5f) * WIDTH, (p.y * invW * 0.5f + 0.5f) * HEIGHT, invW);
+  };
+  glm::vec3 v0 = toScreen(a), v1 = toScreen(b), v2 = toScreen(c);
+
+  float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+  if (std::fabs(area) < 1e-6f)
+  {
+    return;
+  }
+  // we rasterize both windings, so flip to counter-clockwise
+  if (area < 0.0f)
+  {
+    std::swap(v1, v2);
+    area = -area;
+  }
+
+  ScreenTri t;
+  t.minX = std::max(0, int(std::floor(std::min({v0.x, v1.x, v2.x}))));
+  t.maxX = std::min(WIDTH - 1, int(std::floor(std::max({v0.x, v1.x, v2.x}))));
+  t.minY = std::max(0, int(std::floor(std::min({v0.y, v1.y, v2.y}))));
+  t.maxY = std::min(HEIGHT - 1, int(std::floor(std::max({v0.y, v1.y, v2.y}))));
+  if (t.minX > t.maxX || t.minY > t.maxY)
+  {
+    return;
+  }
+
+  // edge i is the one opposite vertex i, positive on the inside
+  const glm::vec3 *v[3] = {&v0, &v1, &v2};
+  for (int i = 0; i < 3; ++i)
+  {
+    const glm::vec3 &p = *v[(i + 1) % 3];
+    const glm::vec3 &q = *v[(i + 2) % 3];
+    t.edgeA[i] = p.y - q.y;
+    t.edgeB[i] = q.x - p.x;
+    t.edgeC[i] = p.x * q.y - p.y * q.x;
+    // top-left rule: a pixel centre right on an edge two triangles share belongs to exactly one of
+    // them. strictly inside on both left a seam down the diagonal of every quad
+    t.topLeft[i] = t.edgeA[i] > 0.0f || (t.edgeA[i] == 0.0f && t.edgeB[i] < 0.0f);
+  }
+  // 1/w is affine in screen space, so it is a plane through the three vertices
+  float invArea = 1.0f / area;
+  t.depthA = (t.edgeA[0] * v0.z + t.edgeA[1] * v1.z + t.edgeA[2] * v2.z) * invArea;
+  t.depthB = (t.edgeB[0] * v0.z + t.edgeB[1] * v1.z + t.edgeB[2] * v2.z) * invArea;
+  t.depthC = (t.edgeC[0] * v0.z + t.edgeC[1] * v1.z + t.edgeC[2] * v2.z) * invArea;
+  triangles.push_back(t);
+}
+
+void OcclusionCuller::rasterize()
+{
+  if (bandCount == 1 || triangles.size() < kMinParallelTriangles)
+  {
+    rasterizeBand(0, HEIGHT);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m);
+    generation++;
+    bandsRemaining = bandCount - 1;
+  }
+  startCv.notify_all();
+
+  rasterizeBand(0, HEIGHT / bandCount);
+
+  std::unique_lock<std::mutex> lock(m);
+  doneCv.wait(lock, [&]
+              { return bandsRemaining == 0; });
+}
+
+void OcclusionCuller::bandWorker(int band)
+{
+  uint64_t seen = 0;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(m);
+      startCv.wait(lock, [&]
+                   { return stopping || generation != seen; });
+      if (stopping)
+      {
+        return;
+      }
+      seen = generation;
+    }
+
+    rasterizeBand(band * HEIGHT / bandCount, (band + 1) * HEIGHT / bandCount);
+
+    {
+      std::lock_guard<std::mutex> lock(m);
+      if (--bandsRemaining == 0)
+      {
+        doneCv.notify_one();
+      }
+    }
+  }
+}
+
+void OcclusionCuller::rasterizeBand(int rowBegin, int rowEnd)
+{
+  const vfloat zero = vset(0.0f);
+  const vfloat lanes = vlanes();
+  auto onInside = [&](vfloat edge, bool topLeft)
+  { return topLeft ? vge(edge, zero) : vgt(edge, zero); };
+
+  for (const ScreenTri &t : triangles)
+  {
+    int minY = std::max(t.minY, rowBegin);
+    int maxY = std::min(t.maxY, rowEnd - 1);
+    if (minY > maxY)
+    {
+      continue;
+    }
+    // WIDTH is a multiple of 4, so aligning the start keeps every 4-pixel step inside the row
+    int minX = t.minX & ~3;
+
+    const vfloat a0 = vset(t.edgeA[0]), a1 = vset(t.edgeA[1]), a2 = vset(t.edgeA[2]);
+    const vfloat za = vset(t.depthA);
+
+    for (int y = minY; y <= maxY; ++y)
+    {
+      // sample at pixel centres
+      float py = float(y) + 0.5f;
+      const vfloat r0 = vset(t.edgeB[0] * py + t.edgeC[0]);
+      const vfloat r1 = vset(t.edgeB[1] * py + t.edgeC[1]);
+      const vfloat r2 = vset(t.edgeB[2] * py + t.edgeC[2]);
+      const vfloat rz = vset(t.depthB * py + t.depthC);
+      float *row = &depth[size_t(y) * WIDTH];
+
+      for (int x = minX; x <= t.maxX; x += 4)
+      {
+        vfloat px = vadd(vset(float(x) + 0.5f), lanes);
+        vfloat inside = vand(vand(onInside(vadd(vmul(a0, px), r0), t.topLeft[0]),
+                                  onInside(vadd(vmul(a1, px), r1), t.topLeft[1])),
+                             onInside(vadd(vmul(a2, px), r2), t.topLeft[2]));
+        if (!vany(inside))
+        {
+          continue;
+        }
+        vfloat z = vadd(vmul(za, px), rz);
+        vfloat current = vload(row + x);
+        vstore(row + x, vselect(inside, vmax(current, z), current));
+      }
+    }
+  }
+}
+
+bool OcclusionCuller::isVisible(const AABB &box) const
+{
+  float minX = float(WIDTH), maxX = -1.0f;
+  float minY = float(HEIGHT), maxY = -1.0f;
+  float nearest = 0.0f;
+  for (int i = 0; i < 8; ++i)
+  {
+    glm::vec4 corner((i & 1) ? box.vmax.x : box.vmin.x,
+                     (i & 2) ? box.vmax.y : box.vmin.y,
+                     (i & 4) ? box.vmax.z : box.vmin.z, 1.0f);
+    glm::vec4 clip = viewProjection * corner;
+    // the camera is inside or right next to the box
+    if (clip.w < kNearW)
+    {
+      return true;
+    }
+    float invW = 1.0f / clip.w;
+    float sx = (clip.x * invW * 0.5f + 0.5f) * WIDTH;
+    float sy = (clip.y * invW * 0.5f + 0.5f) * HEIGHT;
+    minX = std::min(minX, sx);
+    maxX = std::max(maxX, sx);
+    minY = std::min(minY, sy);
+    maxY = std::max(maxY, sy);
+    // depth is linear across the box, so its nearest point is one of the corners
+    nearest = std::max(nearest, invW);
+  }
+
+  int x0 = std::max(0, int(std::floor(minX)));
+  int x1 = std::min(WIDTH - 1, int(std::floor(maxX)));
+  int y0 = std::max(0, int(std::floor(minY)));
+  int y1 = std::min(HEIGHT - 1, int(std::floor(maxY)));
+  if (x0 > x1 || y0 > y1)
+  {
+    // frustum culling already let it through, so don't second guess it
+    return true;
+  }
+
+  const vfloat boxDepth = vset(nearest);
+  const vfloat lanes = vlanes();
+  const vfloat first = vset(float(x0)), last = vset(float(x1));
+  for (int y = y0; y <= y1; ++y)
+  {
+    const float *row = &depth[size_t(y) * WIDTH];
+    for (int x = x0 & ~3; x <= x1; x += 4)
+    {
+      vfloat px = vadd(vset(float(x)), lanes);
+      vfloat inRect = vand(vge(px, first), vle(px, last));
+      // visible if any covered pixel has nothing nearer than the box's closest point
+      if (vany(vand(inRect, vle(vload(row + x), boxDepth))))
+      {
+        return true;
+      }
+    }
+  }
+  return false;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <libs/glm/glm.hpp>
+#include "VoxelTypes.hpp"
+
+/*
+    Software occlusion culling. Each frame the nearby terrain is reduced to
+    solid boxes, those boxes are rasterized into a small depth buffer on the
+    CPU, and every chunk that survived the frustum test is checked against it.
+
+    The buffer stores 1/w so closer is larger and clearing to 0 means
+    "nothing in front". Rasterization is split into horizontal bands, one per
+    thread, so no two threads ever write the same row.
+
+    Nothing here touches GL, so it can run without a window.
+*/
+class OcclusionCuller
+{
+    public:
+    static constexpr int WIDTH = 256;
+    static constexpr int HEIGHT = 128;
+
+    explicit OcclusionCuller(unsigned int threadCount);
+    ~OcclusionCuller();
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    // clears the depth buffer and the occluder list for a new frame
+    void beginFrame(const glm::mat4& viewProjection, const glm::vec3& cameraPos);
+    // a box that is completely solid. only the faces turned toward the camera are kept
+    void addOccluder(const glm::vec3& vmin, const glm::vec3& vmax);
+    void rasterize();
+
+    // false only if every pixel the box could cover already has something nearer in front
+    bool isVisible(const AABB& box) const;
+
+    const std::vector<float>& getDepth() const { return depth; }
+    size_t occluderTriangles() const { return triangles.size(); }
+
+    private:
+    // triangle setup is done once in addTriangle, every band reuses it
+    struct ScreenTri
+    {
+        float edgeA[3], edgeB[3], edgeC[3]; // edge functions A*x + B*y + C in pixels
+        bool topLeft[3];                    // a pixel centre exactly on the edge is inside
+        float depthA, depthB, depthC;       // 1/w plane over the screen
+        int minX, maxX, minY, maxY;         // pixel bounds, already clamped to the buffer
+    };
+
+    void addQuad(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d);
+    void addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+    void rasterizeBand(int rowBegin, int rowEnd);
+    void bandWorker(int band);
+
+    glm::mat4 viewProjection{1.0f};
+    glm::vec3 cameraPos{0.0f};
+    std::vector<ScreenTri> triangles;
+    std::vector<float> depth;
+
+    // band threads: band 0 is always done by the caller of rasterize()
+    int bandCount;
+    std::vector<std::thread> workers;
+    std::mutex m;
+    std::condition_variable startCv, doneCv;
+    uint64_t generation = 0;
+    int bandsRemaining = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,84 @@
+#include "RenderDistanceController.hpp"
+#include <algorithm>
+#include <cstdio>
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
+RenderDistanceController::RenderDistanceController(int radius, const Settings &settings)
+    : settings(settings), current(std::clamp(radius, settings.minRadius, settings.maxRadius))
+{
+}
+
+int RenderDistanceController::update(const Load &load, double intervalSeconds)
+{
+  sinceChange += intervalSeconds;
+
+  const double budget = settings.frameBudgetMs;
+  const double work = load.workP90Ms > 0.0 ? load.workP90Ms : load.frameP90Ms;
+  // a worker that has stalled still counts as one chunk a second, so a stuck queue reads as a backlog
+  const double backlogSeconds = double(load.pendingChunks) / std::max(load.chunksPerSecond, 1.0);
+  const bool memoryKnown = settings.memoryBudgetMiB > 0.0 && load.residentMiB > 0.0;
+
+  const char *over = nullptr;
+  if (load.frameP90Ms > budget * 1.1)
+    over = "frame time over budget";
+  else if (memoryKnown && load.residentMiB > settings.memoryBudgetMiB)
+    over = "memory over budget";
+  else if (backlogSeconds > settings.maxBacklogSeconds)
+    over = "generation falling behind";
+
+  const bool under = work < budget * 0.75 && load.pendingChunks == 0 &&
+                     (!memoryKnown || load.residentMiB < settings.memoryBudgetMiB * 0.85);
+
+  overStreak = over ? overStreak + 1 : 0;
+  underStreak = under ? underStreak + 1 : 0;
+
+  if (over && overStreak >= settings.shrinkAfter && current > settings.minRadius)
+  {
+    // well over budget drops two rings at once, a ring fewer at the edge is a lot less work than it looks
+    const int step = load.frameP90Ms > budget * 1.5 ? 2 : 1;
+    current = std::max(settings.minRadius, current - step);
+    lastReason = over;
+    cooldown = settings.shrinkCooldownSeconds;
+    sinceChange = 0.0;
+    overStreak = underStreak = 0;
+  }
+  else if (underStreak >= settings.growAfter && sinceChange >= cooldown && current < settings.maxRadius)
+  {
+    current++;
+    lastReason = "headroom";
+    cooldown = settings.growCooldownSeconds;
+    sinceChange = 0.0;
+    overStreak = underStreak = 0;
+  }
+  return current;
+}
+
+double RenderDistanceController::residentMiB()
+{
+#if defined(__APPLE__)
+  mach_task_basic_info info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+  {
+    return 0.0;
+  }
+  return double(info.resident_size) / (1024.0 * 1024.0);
+#elif defined(__linux__)
+  // second field is the resident set in pages
+  FILE *statm = std::fopen("/proc/self/statm", "r");
+  if (statm == nullptr)
+  {
+    return 0.0;
+  }
+  long pages = 0, resident = 0;
+  const bool read = std::fscanf(statm, "%ld %ld", &pages, &resident) == 2;
+  std::fclose(statm);
+  return read ? double(resident) * double(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0) : 0.0;
+#else
+  return 0.0;
+#endif
+}
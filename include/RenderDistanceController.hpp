@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include "WorldConfig.hpp"
+
+/*
+    Picks the render distance from how the last few seconds went, so a slow
+    machine backs off instead of stuttering and a fast one sees farther.
+
+    Once an interval (a second in main) it is told the frame time p90, how
+    much of a frame is actual work, how many loaded chunks are still waiting
+    on the workers and how fast they are being generated, and the resident
+    memory. Missing the budget is judged on the whole frame time, headroom
+    only on the work: under vsync a frame never takes less than the refresh
+    interval, however little there is to do. Three things keep it from
+    see-sawing between two distances:
+    - a dead band: it shrinks above 110% of the frame budget but only grows
+      under 75% of it, and only with nothing left to load
+    - it has to see the same verdict for a few intervals in a row
+    - after a shrink it waits a good while before trying to grow again,
+      the frames right after a grow are the loading ones and run slow
+*/
+class RenderDistanceController
+{
+    public:
+    struct Settings
+    {
+        int minRadius = WorldSettings::MIN_RENDER_DISTANCE;
+        int maxRadius = WorldSettings::MAX_RENDER_DISTANCE;
+        // main sets it from the monitor's refresh rate
+        double frameBudgetMs = 1000.0 / 60.0;
+        // 0 leaves memory out of it
+        double memoryBudgetMiB = 0.0;
+        // seconds of generation queued up that count as not keeping up
+        double maxBacklogSeconds = 10.0;
+        int shrinkAfter = 2;
+        int growAfter = 3;
+        double growCooldownSeconds = 3.0;
+        double shrinkCooldownSeconds = 15.0;
+    };
+
+    struct Load
+    {
+        double frameP90Ms = 0.0;
+        // the frame without the wait for the swap, the larger of the CPU's and the GPU's part.
+        // 0 takes frameP90Ms instead
+        double workP90Ms = 0.0;
+        size_t pendingChunks = 0;
+        double chunksPerSecond = 0.0;
+        double residentMiB = 0.0;
+    };
+
+    RenderDistanceController(int radius, const Settings& settings);
+    explicit RenderDistanceController(int radius) : RenderDistanceController(radius, Settings{}) {}
+
+    // returns the radius to use from now on
+    int update(const Load& load, double intervalSeconds);
+    int radius() const { return current; }
+    // why the last change happened, for the log
+    const char* reason() const { return lastReason; }
+
+    // resident set of this process right now, 0 where we can't tell
+    static double residentMiB();
+
+    private:
+    Settings settings;
+    int current;
+    int overStreak = 0, underStreak = 0;
+    double sinceChange = 0.0;
+    double cooldown = 0.0;
+    const char* lastReason = "";
+};
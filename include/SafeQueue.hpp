@@ -5,25 +5,30 @@
 #include <queue>
 #include <condition_variable>
 
+// items are always popped from the highest priority that has any, FIFO within a priority.
+// Low only runs when nothing else is waiting, for work that is just a guess
+enum class QueuePriority : int { High, Normal, Low };
+inline constexpr int QUEUE_PRIORITY_COUNT = 3;
+
 // templated to allow multi types to enter queue?
 template<class T>
 class SafeQueue {
 public:
     // standard push pop methods for a queue
-	void push(const T& val) 
+	void push(const T& val, QueuePriority priority = QueuePriority::Normal) 
     {
         {
             std::lock_guard<std::mutex> lock(_m);
-            _q.push(val);
+            _q[int(priority)].push(val);
         }
         _cv.notify_one();
 	}
 
-    void push(const T&& val) 
+    void push(const T&& val, QueuePriority priority = QueuePriority::Normal) 
     {
         {
             std::lock_guard<std::mutex> lock(_m);
-            _q.push(val);
+            _q[int(priority)].push(val);
         }
         _cv.notify_one();
 	}
@@ -31,19 +36,26 @@ public:
 	T pop() 
     {
         std::unique_lock<std::mutex> lock(_m);
-        _cv.wait(lock, [&]{ return !_q.empty() || _closed == true; });  // blocks here until someone .push()
-        if (_q.empty() && _closed) {
+        _cv.wait(lock, [&]{ return !empty() || _closed == true; });  // blocks here until someone .push()
+        if (empty() && _closed) {
             return T();
         }
-        T item = std::move(_q.front());
-        _q.pop();
-        return item;
+        return takeFront();
     }
 
     bool hasItems() const 
     {
         std::lock_guard<std::mutex> lock(_m);
-        return !_q.empty();
+        return !empty();
+    }
+
+    // items waiting across every priority, already stale by the time the caller looks at it
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        size_t total = 0;
+        for (const auto& q : _q) total += q.size();
+        return total;
     }
 
     bool tryPop(T& out)
@@ -51,9 +63,8 @@ public:
         // may need to distingush closed as empty but still operational
         // vs empty and shutdown
         std::lock_guard<std::mutex> lock(_m);
-        if (_q.empty()) return false;
-        out = std::move(_q.front());
-        _q.pop();
+        if (empty()) return false;
+        out = takeFront();
         return true;
     }
 
@@ -67,9 +78,30 @@ public:
 
 
 private:
+    // callers hold _m
+    bool empty() const
+    {
+        for (const auto& q : _q) {
+            if (!q.empty()) return false;
+        }
+        return true;
+    }
+
+    // front of the highest priority queue that has anything
+    T takeFront()
+    {
+        for (auto& q : _q) {
+            if (q.empty()) continue;
+            T item = std::move(q.front());
+            q.pop();
+            return item;
+        }
+        return T();
+    }
+
     // private memebers 
-	std::mutex _m;
-	std::queue<T> _q;
+	mutable std::mutex _m;
+	std::queue<T> _q[QUEUE_PRIORITY_COUNT];
     std::condition_variable _cv;
     bool _closed = false;
 };
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+    Face-to-face connectivity of a 16^3 section. Faces use the same order as
+    dirOffsets (0=+Z, 1=-Z, 2=+Y, 3=-Y, 4=+X, 5=-X), and each of the 15
+    unordered face pairs gets one bit. A bit is set when some run of
+    non-opaque voxels inside the section touches both faces, which means
+    you could see from one face out through the other.
+*/
+namespace SectionVisibility
+{
+    constexpr uint16_t ALL_CONNECTED = 0x7FFF;
+    constexpr uint16_t NONE_CONNECTED = 0;
+
+    inline int opposite(int face) { return face ^ 1; }
+
+    inline int pairBit(int a, int b)
+    {
+        if (a > b) { int t = a; a = b; b = t; }
+        return a * 5 - a * (a - 1) / 2 + (b - a - 1);
+    }
+
+    inline bool connected(uint16_t set, int a, int b)
+    {
+        return a != b && (set >> pairBit(a, b)) & 1u;
+    }
+
+    // sets every pair among the faces in faceMask (bit i = face i)
+    inline uint16_t connectAll(uint16_t set, uint8_t faceMask)
+    {
+        for (int a = 0; a < 6; a++)
+        {
+            if (!(faceMask & (1u << a))) continue;
+            for (int b = a + 1; b < 6; b++)
+            {
+                if (faceMask & (1u << b)) set |= uint16_t(1u << pairBit(a, b));
+            }
+        }
+        return set;
+    }
+}
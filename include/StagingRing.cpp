@@ -0,0 +1,133 @@
+#include "StagingRing.hpp"
+
+namespace
+{
+  // keeps every allocation on its own cache lines, and well inside any copy alignment a driver likes
+  constexpr size_t ALIGNMENT = 256;
+}
+
+StagingRing::~StagingRing()
+{
+  for (Pending &p : pending)
+  {
+    glDeleteSync(p.fence);
+  }
+  if (buf)
+  {
+    // deleting a mapped buffer unmaps it
+    glDeleteBuffers(1, &buf);
+  }
+}
+
+bool StagingRing::create(size_t bytes)
+{
+  // glad only knows the core version, buffer storage came in with 4.4 (macOS stops at 4.1)
+  if (mapped != nullptr || !GLAD_GL_VERSION_4_4 || glBufferStorage == nullptr)
+  {
+    return false;
+  }
+  const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glGenBuffers(1, &buf);
+  glBindBuffer(GL_COPY_READ_BUFFER, buf);
+  glBufferStorage(GL_COPY_READ_BUFFER, GLsizeiptr(bytes), nullptr, flags);
+  mapped = static_cast<char *>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, GLsizeiptr(bytes), flags));
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  if (mapped == nullptr)
+  {
+    glDeleteBuffers(1, &buf);
+    buf = 0;
+    return false;
+  }
+  size = bytes;
+  return true;
+}
+
+bool StagingRing::allocate(size_t bytes, Allocation &out)
+{
+  const size_t need = (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  if (mapped == nullptr || need == 0 || need >= size)
+  {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(m);
+  size_t start = 0;
+  if (regions.empty())
+  {
+    head = 0;
+  }
+  else
+  {
+    // head never catches up with the tail exactly, so head == tail only ever means empty
+    const size_t tail = regions.front().begin;
+    if (head > tail && size - head >= need)
+      start = head;
+    else if (head > tail && need < tail)
+      start = 0; // the bit past head at the end is skipped, it frees with the allocation before it
+    else if (head < tail && head + need < tail)
+      start = head;
+    else
+      return false;
+  }
+  out.offset = start;
+  out.bytes = bytes;
+  out.data = mapped + start;
+  out.id = firstId + regions.size();
+  regions.push_back(Region{start, start + need, false});
+  head = start + need;
+  return true;
+}
+
+void StagingRing::release(const Allocation &allocation)
+{
+  if (allocation.data != nullptr)
+  {
+    released.push_back(allocation.id);
+  }
+}
+
+void StagingRing::submit()
+{
+  if (mapped == nullptr)
+  {
+    return;
+  }
+  if (!released.empty())
+  {
+    pending.push_back(Pending{glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::move(released)});
+    released.clear();
+  }
+  while (!pending.empty())
+  {
+    // never waits, a fence that isn't through yet is looked at again next frame
+    const GLenum status = glClientWaitSync(pending.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+    {
+      break;
+    }
+    glDeleteSync(pending.front().fence);
+    {
+      std::lock_guard<std::mutex> lock(m);
+      for (uint64_t id : pending.front().ids)
+      {
+        regions[size_t(id - firstId)].done = true;
+      }
+      while (!regions.empty() && regions.front().done)
+      {
+        regions.pop_front();
+        firstId++;
+      }
+    }
+    pending.pop_front();
+  }
+}
+
+size_t StagingRing::bytesInUse() const
+{
+  std::lock_guard<std::mutex> lock(m);
+  if (regions.empty())
+  {
+    return 0;
+  }
+  const size_t tail = regions.front().begin;
+  return head > tail ? head - tail : size - tail + head;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <libs/glad/glad.h>
+
+/*
+    One big buffer, mapped once and left mapped (GL_MAP_PERSISTENT_BIT), that
+    the workers write finished meshes straight into. The render thread then
+    only issues a glCopyBufferSubData per mesh into the chunk's own buffers,
+    no vertex data goes through the driver on that thread any more.
+
+    Space is handed out in allocation order round the ring. An allocation is
+    released once its copy is issued, and the space only comes back after
+    the fence put down behind that frame's copies has signalled, so a worker
+    never overwrites bytes the GPU hasn't read yet. Releases can come in any
+    order, the tail just waits on the oldest allocation.
+
+        // worker
+        StagingRing::Allocation a;
+        if (ring.allocate(bytes, a)) { ...write to a.data... }
+        // render thread
+        mesh.copyFrom(ring.buffer(), a.offset, ...);
+        ring.release(a);
+        ...
+        ring.submit();   // once a frame, after the copies
+
+    Needs GL 4.4 (buffer storage). Without it create() returns false, every
+    allocate() fails and the chunks keep their meshes in vectors as before.
+*/
+class StagingRing
+{
+    public:
+    static constexpr size_t DEFAULT_BYTES = size_t(32) << 20;
+
+    struct Allocation
+    {
+        size_t offset = 0;
+        size_t bytes = 0;
+        char* data = nullptr;
+        uint64_t id = 0;
+    };
+
+    StagingRing() = default;
+    ~StagingRing();
+
+    StagingRing(const StagingRing&) = delete;
+    StagingRing& operator=(const StagingRing&) = delete;
+
+    // render thread with the context current
+    bool create(size_t bytes = DEFAULT_BYTES);
+    bool active() const { return mapped != nullptr; }
+    GLuint buffer() const { return buf; }
+
+    // any thread. false when the ring is off or too full right now, the caller keeps the data itself
+    bool allocate(size_t bytes, Allocation& out);
+    // these two belong to the thread issuing the copies, the render thread or the world's upload
+    // thread while it runs. release once the copy out of it has been issued (or never will be)
+    void release(const Allocation& allocation);
+    // after a frame's (or an upload batch's) copies. fences those releases and takes back the
+    // space of earlier ones the GPU is done with
+    void submit();
+
+    size_t bytesInUse() const;
+    size_t capacity() const { return size; }
+
+    private:
+    struct Region
+    {
+        size_t begin, end;
+        bool done;
+    };
+    struct Pending
+    {
+        GLsync fence;
+        std::vector<uint64_t> ids;
+    };
+
+    GLuint buf = 0;
+    char* mapped = nullptr;
+    size_t size = 0;
+
+    mutable std::mutex m;
+    // live allocations oldest first, regions[i] has id firstId + i
+    std::deque<Region> regions;
+    uint64_t firstId = 1;
+    size_t head = 0;
+
+    // copying thread only
+    std::vector<uint64_t> released;
+    std::deque<Pending> pending;
+};
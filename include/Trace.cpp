@@ -0,0 +1,126 @@
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Trace
+{
+  std::atomic<bool> recording{false};
+
+  namespace
+  {
+    struct Event
+    {
+      const char *name;
+      int64_t start;
+      int64_t end;
+    };
+
+    // written only by its thread. head counts every event ever written, the slot is head % RING_SIZE
+    struct Ring
+    {
+      int id = 0;
+      std::string threadName;
+      std::atomic<uint64_t> head{0};
+      Event events[RING_SIZE];
+    };
+
+    std::mutex ringsMutex;
+    std::vector<std::unique_ptr<Ring>> rings;
+
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    Ring &threadRing()
+    {
+      thread_local Ring *ring = nullptr;
+      if (ring == nullptr)
+      {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.push_back(std::make_unique<Ring>());
+        ring = rings.back().get();
+        ring->id = int(rings.size());
+        ring->threadName = "thread " + std::to_string(ring->id);
+      }
+      return *ring;
+    }
+  }
+
+  void setEnabled(bool enabled)
+  {
+    recording.store(enabled, std::memory_order_relaxed);
+  }
+
+  void setThreadName(const char *name)
+  {
+    Ring &ring = threadRing();
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    ring.threadName = name;
+  }
+
+  int64_t now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+  }
+
+  void record(const char *name, int64_t startNs, int64_t endNs)
+  {
+    Ring &ring = threadRing();
+    const uint64_t head = ring.head.load(std::memory_order_relaxed);
+    ring.events[head % RING_SIZE] = Event{name, startNs, endNs};
+    // publishes the event, a reader that sees this head sees the write above
+    ring.head.store(head + 1, std::memory_order_release);
+  }
+
+  bool writeChromeJson(const std::string &path)
+  {
+    std::ofstream out(path);
+    if (!out)
+    {
+      return false;
+    }
+    // microseconds, to the nanosecond
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    auto separator = [&]() -> std::ofstream &
+    {
+      out << (first ? "" : ",\n");
+      first = false;
+      return out;
+    };
+
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    std::vector<Event> copy;
+    for (const std::unique_ptr<Ring> &ring : rings)
+    {
+      separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << ring->id
+                  << ",\"args\":{\"name\":\"" << ring->threadName << "\"}}";
+
+      // copy what is there, then drop whatever the writer may have lapped while we copied,
+      // including the slot it may be halfway through writing
+      const uint64_t before = ring->head.load(std::memory_order_acquire);
+      const uint64_t oldest = before > RING_SIZE ? before - RING_SIZE : 0;
+      copy.clear();
+      for (uint64_t i = oldest; i < before; ++i)
+      {
+        copy.push_back(ring->events[i % RING_SIZE]);
+      }
+      const uint64_t after = ring->head.load(std::memory_order_acquire);
+      const uint64_t overwritten = after + 1 > RING_SIZE ? std::min(after + 1 - RING_SIZE, before) : 0;
+      const size_t skip = size_t(overwritten > oldest ? overwritten - oldest : 0);
+
+      for (size_t i = skip; i < copy.size(); ++i)
+      {
+        const Event &event = copy[i];
+        separator() << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << ring->id
+                    << ",\"ts\":" << double(event.start) / 1000.0 << ",\"dur\":" << double(event.end - event.start) / 1000.0 << "}";
+      }
+    }
+    out << "\n]}\n";
+    return bool(out);
+  }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*
+    Scoped timing zones for looking at where a frame or a chunk's trip
+    through the workers goes, written out as Chrome trace JSON (open it in
+    chrome://tracing or ui.perfetto.dev).
+
+        void World::cullChunks()
+        {
+          TRACE_ZONE("cull");
+          ...
+
+    Each thread writes finished zones into its own ring of RING_SIZE events,
+    nothing is shared and nothing is locked on the way in. A full ring
+    overwrites its oldest events. Rings stay around after their thread has
+    exited so a dump still shows it.
+
+    Recording is off until setEnabled(true), and a zone only checks one
+    relaxed flag then. Build with -DTRACE_ENABLED=0 and TRACE_ZONE expands
+    to nothing at all.
+*/
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+namespace Trace
+{
+    inline constexpr uint32_t RING_SIZE = 1u << 16;
+
+    extern std::atomic<bool> recording;
+
+    inline bool enabled() { return recording.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+    // shown as the thread's name in the viewer, call it from the thread itself
+    void setThreadName(const char* name);
+    // nanoseconds on the steady clock since the first trace call
+    int64_t now();
+    // name must outlive the dump, string literals do
+    void record(const char* name, int64_t startNs, int64_t endNs);
+
+    // every ring's events as a Chrome trace, safe while other threads keep recording
+    // (events overwritten during the copy are left out). false if the file can't be written
+    bool writeChromeJson(const std::string& path);
+
+    class Zone
+    {
+        public:
+        explicit Zone(const char* name) : name(enabled() ? name : nullptr), start(this->name ? now() : 0) {}
+        ~Zone()
+        {
+            if (name != nullptr)
+            {
+                record(name, start, now());
+            }
+        }
+
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+        private:
+        const char* name;
+        int64_t start;
+    };
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#if TRACE_ENABLED
+#define TRACE_ZONE(name) Trace::Zone TRACE_CONCAT(traceZone, __LINE__)(name)
+#else
+#define TRACE_ZONE(name) ((void)0)
+#endif
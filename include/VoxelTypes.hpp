@@ -6,6 +6,7 @@
 #include <libs/glad/glad.h>
 #include <libs/glm/glm.hpp>
 #include <libs/glm/gtc/matrix_transform.hpp>
+#include <functional>
 #include <unordered_map>
 #include <string>
 #include <vector>
@@ -14,7 +15,22 @@ using namespace std;
 class Chunk;
 
 // type is explicitly set the 8bit int taking less space for 1000s of blocks
-enum class BlockType : uint8_t { NoBlock, Air, Dirt, Grass, Stone };
+enum class BlockType : uint8_t { NoBlock, Air, Dirt, Grass, Stone, Glowstone };
+// keep in step with the enum, used to size per-type tables
+inline constexpr int BLOCK_TYPE_COUNT = 6;
+
+// light levels are 4 bits, 15 is full sunlight or a torch-bright source
+inline constexpr uint8_t MAX_LIGHT = 15;
+
+// block light a block gives off, 0 for everything that isn't a light source
+inline uint8_t blockEmission(BlockType type) {
+    return type == BlockType::Glowstone ? MAX_LIGHT : 0;
+}
+
+// every block is opaque to light, only air (and NoBlock past the loaded world) lets it through
+inline bool blocksLight(BlockType type) {
+    return type != BlockType::Air && type != BlockType::NoBlock;
+}
 
 struct Block {
     BlockType b_type;
@@ -31,6 +47,7 @@ inline const std::unordered_map<BlockType, BlockFaceOffsets> blockTextureOffsets
     { BlockType::Dirt,  { {24, 29}, {24, 29}, {24, 29} } }, // all faces use tile at (1, 2)
     { BlockType::Grass, { {29, 22}, {28, 24}, {24, 29} } }, // top (0,0), sides (2,0), bottom (1,2)
     { BlockType::Stone, { {30, 2}, {30, 2}, {30, 2} } }, // all faces use tile at (3,1)
+    { BlockType::Glowstone, { {28, 28}, {28, 28}, {28, 28} } },
 };
 
 struct Plane {
@@ -90,16 +107,52 @@ struct AABB {
     glm::vec3 vmax;
 };
 
+// vertical extent of the geometry a section emitted, empty when minY > maxY
+struct SectionBounds {
+    float minY;
+    float maxY;
+
+    bool empty() const { return minY > maxY; }
+};
+
+// a box of blocks lifted out of the world by World::copyRegion, x fastest then z then y
+struct VoxelBuffer {
+    glm::ivec3 size{0};
+    std::vector<BlockType> blocks;
+
+    BlockType& at(int x, int y, int z) { return blocks[x + size.x * (z + size.z * y)]; }
+    BlockType at(int x, int y, int z) const { return blocks[x + size.x * (z + size.z * y)]; }
+};
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction; // doesn't need to be normalized
+    float maxDistance;
+};
+
+struct RayHit {
+    bool hit = false;
+    glm::ivec3 block{0};   // the solid block the ray stopped in
+    glm::ivec3 normal{0};  // face it came in through, zero if the ray started inside it
+    float distance = 0.0f;
+    BlockType type = BlockType::NoBlock;
+};
+
 struct Vertex {
     glm::vec3 Position; // half-precision 3-component float vector
     glm::vec3 Normal;
     glm::vec2 TexCoords;
+    glm::vec2 Light{1.0f, 0.0f}; // sky and block light of the cell the face looks into, 0..1
+    float Occlusion = 1.0f;      // ambient occlusion at this corner, 0 (three blocks around it) to 1 (open)
 };
 
-enum class JobType { GenerateAndBuild, BuildOnly };
+// Prefetch generates and lights a chunk that isn't loaded yet, it is meshed once it is
+enum class JobType { GenerateAndBuild, BuildOnly, Prefetch, Task };
 struct ChunkJob {
   Chunk*  chunk;
   JobType   type;
+  // background work that isn't a chunk (JobType::Task, chunk is null)
+  std::function<void()> task{};
 };
 
 struct PairHash {
@@ -1,28 +1,71 @@
 #include <unordered_map>
+#include <deque>
 #include <memory>
 #include <thread>
 #include <utility>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <condition_variable>
 #include "World.hpp"
+#include "WorldAccessor.hpp"
+#include "LightPropagator.hpp"
 #include "SafeQueue.hpp"
 #include "shader_m.h"
 #include "VoxelTypes.hpp"
 #include "scripts/Loader.h"
 #include "WorldConfig.hpp"
+#include "SectionVisibility.hpp"
+#include "Log.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
 #include "libs/glad/glad.h"
 #include "libs/glfw/glfw3.h"
 #include <libs/glm/glm.hpp>
 #include <libs/glm/gtc/matrix_transform.hpp>
 #include <libs/glm/gtc/type_ptr.hpp>
 
+namespace
+{
+  int64_t steadyTicks()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // a block's own section, plus the one above or below when it sits on that boundary
+  uint16_t sectionsAround(int y)
+  {
+    const int section = y / WorldSettings::SECTION_HEIGHT, ly = y % WorldSettings::SECTION_HEIGHT;
+    uint16_t sections = uint16_t(1u << section);
+    if (ly == 0 && section > 0)
+    {
+      sections |= uint16_t(1u << (section - 1));
+    }
+    if (ly == WorldSettings::SECTION_HEIGHT - 1 && section < WorldSettings::SECTION_COUNT - 1)
+    {
+      sections |= uint16_t(1u << (section + 1));
+    }
+    return sections;
+  }
+}
+
 World::World()
+    : occlusion(std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u))
 {
   atlasText = Loader::loadTexture("assets/textures/block_atlas.png");
+  // before the workers start, they check it for every mesh
+  if (!staging.create())
+  {
+    LOG_INFO("no buffer storage, meshes upload from the render thread");
+  }
   startWorldThreads();
   init_noise();
 }
 
 World::~World()
 {
+  stopUploadThread();
   generateQueue.close();
   uploadQueue.close();
   for (auto &t : threads)
@@ -31,127 +74,1322 @@ World::~World()
   }
 }
 
-BlockType World::getChunk(int nChunkX, int nChunkZ, int tx, int ty, int tz)
+void World::loadChunk(int cx, int cz)
 {
-  int nx = (tx % WorldSettings::CHUNK_WIDTH + WorldSettings::CHUNK_WIDTH) % WorldSettings::CHUNK_WIDTH;
-  int nz = (tz % WorldSettings::CHUNK_WIDTH + WorldSettings::CHUNK_WIDTH) % WorldSettings::CHUNK_WIDTH;
+  auto key = std::make_pair(cx, cz);
+  if (chunks.find(key) != chunks.end())
+  {
+    return;
+  }
+
+  static Metrics::Counter &prefetchHits = Metrics::counter("prefetch hits");
+  static Metrics::Counter &prefetchLate = Metrics::counter("prefetch late");
+
+  // a prefetched chunk that is already generated only needs its mesh. one still waiting on a worker
+  // is sitting behind everything else at low priority, it is cheaper to start over at normal
+  std::unique_ptr<Chunk> newChunk;
+  auto cached = prefetchedChunks.find(key);
+  if (cached != prefetchedChunks.end())
+  {
+    std::unique_ptr<Chunk> prefetchedChunk = std::move(cached->second);
+    prefetchedChunks.erase(cached);
+    if (prefetchedChunk->generated.load())
+    {
+      newChunk = std::move(prefetchedChunk);
+      newChunk->prefetched = false;
+      prefetchHits.add();
+    }
+    else
+    {
+      dropPrefetched(std::move(prefetchedChunk));
+      prefetchLate.add();
+    }
+  }
+  const bool adopted = newChunk != nullptr;
+  if (!adopted)
+  {
+    newChunk = std::make_unique<Chunk>(cx, cz, *this, noise);
+  }
+
+  Chunk *rawChunkPtr = newChunk.get();
+  rawChunkPtr->hasBeenGenerated = true;
+  rawChunkPtr->cullSlot = culler.add(rawChunkPtr->getBox(), rawChunkPtr);
+  {
+    std::unique_lock<std::shared_mutex> lock(chunksMutex);
+    chunks.emplace(key, std::move(newChunk));
+  }
+  rawChunkPtr->lod = lodFor(cx, cz);
+  if (adopted)
+  {
+    // if its prefetch job hasn't come back through the upload queue yet, this remesh is queued from there
+    scheduleMesh(rawChunkPtr, uint16_t((1u << WorldSettings::SECTION_COUNT) - 1));
+  }
+  else
+  {
+    // upload new chunk to the queue for a thread to take
+    rawChunkPtr->scheduled = true;
+    generateQueue.push(ChunkJob{rawChunkPtr, JobType::GenerateAndBuild});
+  }
+  unstitchedChunks.push_back(rawChunkPtr);
+  stats.chunksLoaded++;
+}
 
-  auto key = std::make_pair(nChunkX, nChunkZ);
+void World::dropPrefetched(std::unique_ptr<Chunk> chunk)
+{
+  static Metrics::Counter &prefetchWasted = Metrics::counter("prefetch wasted");
+  static Metrics::Counter &prefetchCancelled = Metrics::counter("prefetch cancelled");
+  // generated for nothing, or at least dropped before a worker spent anything on it
+  if (chunk->generated.load())
+  {
+    prefetchWasted.add();
+  }
+  else
+  {
+    chunk->prefetchCancelled = true;
+    prefetchCancelled.add();
+  }
+  chunk->unloaded = true;
+  // never in the loaded map, so no accessor can have it and it can go as soon as its job is back
+  chunk->retiredEpoch = 0;
+  retiredChunks.push_back(std::move(chunk));
+}
 
-  auto it = chunks.find(key);
-  if (it == chunks.end() || it->second->hasBeenGenerated == false)
+void World::setPrefetching(bool enabled)
+{
+  prefetching = enabled;
+  if (!enabled)
   {
-    return BlockType::NoBlock;
+    for (auto &[key, chunk] : prefetchedChunks)
+    {
+      dropPrefetched(std::move(chunk));
+    }
+    prefetchedChunks.clear();
   }
-  return it->second->getBlock(nx, ty, nz);
 }
 
-void World::updateVisibleChunks()
+void World::prefetchChunks()
 {
-  visibleChunks.clear();
-  // figure out which chunk the player is in
-  int playerChunkX = int(floor(playerPos.x / WorldSettings::CHUNK_WIDTH));
-  int playerChunkZ = int(floor(playerPos.z / WorldSettings::CHUNK_DEPTH));
+  static Metrics::Counter &prefetchQueued = Metrics::counter("prefetch queued");
+  static Metrics::Gauge &prefetchCached = Metrics::gauge("prefetch cached");
+  static Metrics::Gauge &prefetchHitRate = Metrics::gauge("prefetch hit rate %");
+  static Metrics::Counter &prefetchHits = Metrics::counter("prefetch hits");
+  static Metrics::Counter &prefetchLate = Metrics::counter("prefetch late");
+  static Metrics::Counter &prefetchWasted = Metrics::counter("prefetch wasted");
+
+  // the near plane faces the way the camera looks
+  const glm::vec3 forward = frustumPlanes.size() > 4 ? glm::vec3(frustumPlanes[4]) : glm::vec3(0.0f, 0.0f, -1.0f);
+  prefetcher.observe(playerPos, glm::length(forward) > 0.0f ? glm::normalize(forward) : forward,
+                     double(steadyTicks()) / 1e9);
+  if (!prefetching)
+  {
+    return;
+  }
+
+  // past the farthest a prediction can reach, the camera has turned away from these
+  const int cx = streamer.getCenterX(), cz = streamer.getCenterZ();
+  const int keep = streamer.getRadius() + ChunkPrefetcher::REACH + 1;
+  for (auto it = prefetchedChunks.begin(); it != prefetchedChunks.end();)
+  {
+    if (std::max(std::abs(it->first.first - cx), std::abs(it->first.second - cz)) > keep)
+    {
+      dropPrefetched(std::move(it->second));
+      it = prefetchedChunks.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  prefetcher.predict(cx, cz, streamer.getRadius(), predictedChunks);
+  int queued = 0;
+  for (const std::pair<int, int> &key : predictedChunks)
+  {
+    if (queued == PREFETCH_PER_FRAME || prefetchedChunks.size() >= PREFETCH_LIMIT)
+    {
+      break;
+    }
+    if (prefetchedChunks.count(key) != 0 || chunks.count(key) != 0)
+    {
+      continue;
+    }
+    auto chunk = std::make_unique<Chunk>(key.first, key.second, *this, noise);
+    chunk->prefetched = true;
+    chunk->generateOnly = true;
+    chunk->scheduled = true;
+    generateQueue.push(ChunkJob{chunk.get(), JobType::Prefetch}, QueuePriority::Low);
+    prefetchedChunks.emplace(key, std::move(chunk));
+    prefetchQueued.add();
+    queued++;
+  }
+
+  prefetchCached.set(double(prefetchedChunks.size()));
+  // of the prefetches that have been settled one way or the other, the share that paid off
+  const int64_t hits = prefetchHits.total(), settled = hits + prefetchLate.total() + prefetchWasted.total();
+  prefetchHitRate.set(settled > 0 ? 100.0 * double(hits) / double(settled) : 0.0);
+}
+
+void World::unloadChunk(int cx, int cz)
+{
+  auto it = chunks.find(std::make_pair(cx, cz));
+  if (it == chunks.end())
+  {
+    return;
+  }
+
+  std::unique_ptr<Chunk> chunk;
+  {
+    std::unique_lock<std::shared_mutex> lock(chunksMutex);
+    chunk = std::move(it->second);
+    chunks.erase(it);
+  }
+  culler.remove(chunk->cullSlot);
+  std::erase(unstitchedChunks, chunk.get());
+  chunk->unloaded = true;
+  // out of the map now, so only accessors pinned before this bump can still be holding it
+  chunk->retiredEpoch = ++chunkEpoch;
+  // a worker may still be meshing it or it may be sitting in the upload queue
+  retiredChunks.push_back(std::move(chunk));
+  stats.chunksUnloaded++;
+}
+
+void World::scheduleMesh(Chunk *chunk, uint16_t sections, QueuePriority priority)
+{
+  chunk->dirtySections |= sections;
+  chunk->remeshPriority = std::min(chunk->remeshPriority, priority);
+  // a chunk already in flight is queued again once its current mesh has been uploaded
+  if (chunk->scheduled.load())
+  {
+    return;
+  }
+  chunk->scheduled = true;
+  generateQueue.push(ChunkJob{chunk, JobType::BuildOnly}, chunk->remeshPriority);
+  chunk->remeshPriority = QueuePriority::Normal;
+}
+
+bool World::setBlock(int x, int y, int z, BlockType type)
+{
+  constexpr int W = WorldSettings::CHUNK_WIDTH;
+  constexpr int D = WorldSettings::CHUNK_DEPTH;
+  if (y < 0 || y >= WorldSettings::CHUNK_HEIGHT)
+  {
+    return false;
+  }
+  WorldAccessor access(*this);
+  const int cx = WorldAccessor::chunkCoord(x), cz = WorldAccessor::chunkCoord(z);
+  Chunk *chunk = access.chunkAt(cx, cz);
+  if (chunk == nullptr || !chunk->generated.load())
+  {
+    return false;
+  }
+  const int lx = WorldAccessor::localCoord(x), lz = WorldAccessor::localCoord(z);
+  if (chunk->getBlock(lx, y, lz) == type)
+  {
+    return true;
+  }
+  // a worker meshing this chunk right now may see a mix of old and new (blocks are relaxed
+  // atomics, so that is all it can see), the dirty bits below make sure it goes round again
+  chunk->setBlock(lx, y, lz, type);
+  stats.blockEdits++;
+
+  int64_t now = steadyTicks();
+  auto touch = [&](Chunk *c, uint16_t sections)
+  {
+    if (c != nullptr)
+    {
+      markEdited(c, sections, now);
+    }
+  };
+
+  // relight before anything is queued so the remeshes see the new light
+  auto lightStart = std::chrono::steady_clock::now();
+  std::vector<std::pair<Chunk *, uint16_t>> lit;
+  LightPropagator light(*this, cx, cz);
+  light.blockChanged(x, y, z);
+  light.run();
+  light.collectTouched(lit);
+  stats.relights++;
+  stats.relightMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - lightStart).count();
+  for (auto &[c, sections] : lit)
+  {
+    touch(c, sections);
+  }
+
+  // faces of the blocks next to this one change too, and so does the corner shading of faces
+  // one block further out, so a block on a section or chunk border drags the sections on the
+  // other side along. on a chunk corner that includes the chunk diagonally across
+  const uint16_t around = sectionsAround(y);
+  touch(chunk, around);
+  const int sx = lx == 0 ? -1 : lx == W - 1 ? 1 : 0;
+  const int sz = lz == 0 ? -1 : lz == D - 1 ? 1 : 0;
+  if (sx != 0) touch(access.chunkAt(cx + sx, cz), around);
+  if (sz != 0) touch(access.chunkAt(cx, cz + sz), around);
+  if (sx != 0 && sz != 0) touch(access.chunkAt(cx + sx, cz + sz), around);
+  return true;
+}
+
+void World::markEdited(Chunk *chunk, uint16_t sections, int64_t ticks)
+{
+  // latency is measured from the oldest edit the next mesh will carry
+  int64_t none = 0;
+  chunk->editTicks.compare_exchange_strong(none, ticks);
+  scheduleMesh(chunk, sections, QueuePriority::High);
+}
+
+BlockType World::getBlock(int x, int y, int z)
+{
+  // one-off queries, anything reading many blocks should keep its own accessor
+  WorldAccessor access(*this);
+  return access.getBlock(x, y, z);
+}
+
+RayHit World::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance)
+{
+  WorldAccessor access(*this);
+  return castRay(access, origin, direction, maxDistance);
+}
+
+RayHit World::castRay(WorldAccessor &access, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance)
+{
+  constexpr int W = WorldSettings::CHUNK_WIDTH;
+  constexpr int D = WorldSettings::CHUNK_DEPTH;
+  constexpr int H = WorldSettings::SECTION_HEIGHT;
+  constexpr float inf = std::numeric_limits<float>::infinity();
+
+  RayHit hit;
+  const float length = glm::length(direction);
+  if (length == 0.0f)
+  {
+    return hit;
+  }
+  const glm::vec3 dir = direction / length;
+
+  // Amanatides & Woo: tMax is the distance to the next boundary on each axis, tDelta the
+  // distance between boundaries, and every step crosses whichever boundary is nearest
+  glm::ivec3 voxel = glm::ivec3(glm::floor(origin));
+  glm::ivec3 step(0);
+  glm::vec3 tDelta(inf), tMax(inf);
+  for (int i = 0; i < 3; ++i)
+  {
+    if (dir[i] == 0.0f)
+    {
+      continue;
+    }
+    step[i] = dir[i] > 0.0f ? 1 : -1;
+    tDelta[i] = std::abs(1.0f / dir[i]);
+    tMax[i] = (float(step[i] > 0 ? voxel[i] + 1 : voxel[i]) - origin[i]) / dir[i];
+  }
+  float t = 0.0f;
+  glm::ivec3 normal(0);
 
-  // loop a 3×3 (or NxN) area around that chunk
-  static constexpr int R = 10;
-  for (int dz = -R; dz <= R; ++dz)
+  // only asked for again when the walk crosses into another column
+  Chunk *chunk = nullptr;
+  int chunkX = std::numeric_limits<int>::min(), chunkZ = 0;
+
+  while (t <= maxDistance)
   {
-    for (int dx = -R; dx <= R; ++dx)
+    // above or below the world and heading further out
+    if ((voxel.y >= WorldSettings::CHUNK_HEIGHT && step.y >= 0) || (voxel.y < 0 && step.y <= 0))
     {
-      int cx = playerChunkX + dx;
-      int cz = playerChunkZ + dz;
-      auto key = std::make_pair(cx, cz);
+      break;
+    }
 
-      // if we haven’t generated that chunk yet, do so and store it
-      auto it = chunks.find(key);
-      if (it == chunks.end())
+    const int cx = WorldAccessor::chunkCoord(voxel.x), cz = WorldAccessor::chunkCoord(voxel.z);
+    if (cx != chunkX || cz != chunkZ)
+    {
+      chunkX = cx;
+      chunkZ = cz;
+      chunk = access.chunkAt(cx, cz);
+      if (chunk != nullptr && !chunk->generated.load())
       {
-        auto newChunk = std::make_unique<Chunk>(cx, cz, *this, noise);
-        Chunk *rawChunkPtr = newChunk.get();
-        rawChunkPtr->hasBeenGenerated = true;
-        it = chunks.emplace(key, std::move(newChunk)).first;
-        // upload new chunk to the queue for a thread to take
-        generateQueue.push(ChunkJob{rawChunkPtr, JobType::GenerateAndBuild});
-        rawChunkPtr->scheduled = true;
+        chunk = nullptr;
+      }
+    }
+
+    // a box with nothing in it to hit: a column that isn't loaded or a section of air
+    bool skip = false;
+    glm::ivec3 boxMin, boxMax;
+    if (voxel.y >= 0 && voxel.y < WorldSettings::CHUNK_HEIGHT)
+    {
+      const int section = voxel.y / H;
+      if (chunk == nullptr)
+      {
+        boxMin = glm::ivec3(cx * W, 0, cz * D);
+        boxMax = boxMin + glm::ivec3(W, WorldSettings::CHUNK_HEIGHT, D);
+        skip = true;
+      }
+      else if (chunk->sectionBlockCount(section) == 0)
+      {
+        boxMin = glm::ivec3(cx * W, section * H, cz * D);
+        boxMax = boxMin + glm::ivec3(W, H, D);
+        skip = true;
       }
       else
       {
-        Chunk *exisitngChunk = it->second.get();
-        if (exisitngChunk->dirty.load(std::memory_order_relaxed) && !exisitngChunk->scheduled.load(std::memory_order_relaxed))
+        BlockType type = chunk->getBlock(WorldAccessor::localCoord(voxel.x), voxel.y, WorldAccessor::localCoord(voxel.z));
+        if (type != BlockType::Air)
+        {
+          hit.hit = true;
+          hit.block = voxel;
+          hit.normal = normal;
+          hit.distance = t;
+          hit.type = type;
+          return hit;
+        }
+      }
+    }
+
+    int axis;
+    if (skip)
+    {
+      // jump straight to where the ray leaves the box and restart the walk there
+      float exit = inf;
+      axis = 0;
+      for (int i = 0; i < 3; ++i)
+      {
+        if (step[i] == 0)
+        {
+          continue;
+        }
+        float te = (float(step[i] > 0 ? boxMax[i] : boxMin[i]) - origin[i]) / dir[i];
+        if (te < exit)
+        {
+          exit = te;
+          axis = i;
+        }
+      }
+      t = std::max(exit, t);
+      const glm::vec3 p = origin + dir * t;
+      for (int i = 0; i < 3; ++i)
+      {
+        if (i == axis)
+        {
+          continue;
+        }
+        voxel[i] = std::clamp(int(std::floor(p[i])), boxMin[i], boxMax[i] - 1);
+        if (step[i] != 0)
+        {
+          tMax[i] = (float(step[i] > 0 ? voxel[i] + 1 : voxel[i]) - origin[i]) / dir[i];
+        }
+      }
+      voxel[axis] = step[axis] > 0 ? boxMax[axis] : boxMin[axis] - 1;
+      tMax[axis] = t + tDelta[axis];
+    }
+    else
+    {
+      axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+      t = tMax[axis];
+      voxel[axis] += step[axis];
+      tMax[axis] += tDelta[axis];
+    }
+    normal = glm::ivec3(0);
+    normal[axis] = -step[axis];
+  }
+  return hit;
+}
+
+void World::raycast(const std::vector<Ray> &rays, std::vector<RayHit> &hits)
+{
+  // batches keep the job overhead small next to the rays, and each shares one accessor
+  constexpr size_t batch = 256;
+  hits.resize(rays.size());
+  parallelFor((rays.size() + batch - 1) / batch, [&](size_t b)
+              {
+    WorldAccessor access(*this);
+    const size_t end = std::min(rays.size(), (b + 1) * batch);
+    for (size_t i = b * batch; i < end; ++i)
+    {
+      hits[i] = castRay(access, rays[i].origin, rays[i].direction, rays[i].maxDistance);
+    } });
+}
+
+size_t World::pendingChunks() const
+{
+  size_t pending = 0;
+  for (const auto &[key, chunk] : chunks)
+  {
+    pending += chunk->scheduled.load() ? 1 : 0;
+  }
+  return pending;
+}
+
+void World::parallelFor(size_t count, const std::function<void(size_t)> &body)
+{
+  if (count == 0)
+  {
+    return;
+  }
+  // helper jobs can still be sitting in the queue after we return, so the counters are shared.
+  // a late helper finds nothing left and never touches body
+  struct Batch
+  {
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    std::mutex m;
+    std::condition_variable cv;
+  };
+  auto batch = std::make_shared<Batch>();
+  const std::function<void(size_t)> *work = &body;
+  auto drain = [batch, count, work]
+  {
+    for (size_t i = batch->next++; i < count; i = batch->next++)
+    {
+      (*work)(i);
+      if (++batch->done == count)
+      {
+        std::lock_guard<std::mutex> lock(batch->m);
+        batch->cv.notify_all();
+      }
+    }
+  };
+
+  size_t helpers = std::min(threads.size(), count - 1);
+  for (size_t h = 0; h < helpers; ++h)
+  {
+    generateQueue.push(ChunkJob{nullptr, JobType::Task, drain}, QueuePriority::High);
+  }
+  // the caller works too, so this finishes even if every worker is stuck in a long mesh
+  drain();
+  std::unique_lock<std::mutex> lock(batch->m);
+  batch->cv.wait(lock, [&]
+                 { return batch->done.load() == count; });
+}
+
+void World::chunksInRegion(const glm::ivec3 &min, const glm::ivec3 &max, std::vector<Chunk *> &out)
+{
+  out.clear();
+  if (max.x <= min.x || max.z <= min.z)
+  {
+    return;
+  }
+  const int cx0 = WorldAccessor::chunkCoord(min.x), cx1 = WorldAccessor::chunkCoord(max.x - 1);
+  const int cz0 = WorldAccessor::chunkCoord(min.z), cz1 = WorldAccessor::chunkCoord(max.z - 1);
+  WorldAccessor access(*this);
+  for (int cz = cz0; cz <= cz1; ++cz)
+  {
+    for (int cx = cx0; cx <= cx1; ++cx)
+    {
+      Chunk *chunk = access.chunkAt(cx, cz);
+      if (chunk != nullptr && chunk->generated.load())
+      {
+        out.push_back(chunk);
+      }
+    }
+  }
+}
+
+int World::editRegion(const glm::ivec3 &min, const glm::ivec3 &max, const std::function<BlockType(int, int, int)> &blockFor)
+{
+  TRACE_ZONE("edit region");
+  constexpr int W = WorldSettings::CHUNK_WIDTH;
+  constexpr int D = WorldSettings::CHUNK_DEPTH;
+  auto start = std::chrono::steady_clock::now();
+
+  const int y0 = std::max(min.y, 0), y1 = std::min(max.y, WorldSettings::CHUNK_HEIGHT);
+  std::vector<Chunk *> targets;
+  chunksInRegion(min, max, targets);
+
+  // what each chunk's task changed: its own sections plus, per side (-x, +x, -z, +z) and
+  // corner (-x-z, +x-z, -x+z, +x+z), the sections whose border blocks changed and so need
+  // the neighbour remeshed
+  struct ChunkEdit
+  {
+    int changed = 0;
+    uint16_t sections = 0;
+    uint16_t border[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    // Chunk::cellIndex of every changed block, for the relight
+    std::vector<uint16_t> cells;
+  };
+  static_assert(WorldSettings::CHUNK_SIZE <= 1 << 16, "cell indices are kept in 16 bits");
+  std::vector<ChunkEdit> results(targets.size());
+
+  // one task per chunk, so each chunk's blocks and section counts still have a single writer
+  // (Chunk::setBlock counts on that). workers meshing a neighbour meanwhile read the relaxed
+  // atomics, and are sent round again by the remeshes queued below
+  parallelFor(targets.size(), [&](size_t i)
+              {
+    Chunk *chunk = targets[i];
+    ChunkEdit &edit = results[i];
+    const int ox = chunk->chunkX * W, oz = chunk->chunkZ * D;
+    const int x0 = std::max(min.x - ox, 0), x1 = std::min(max.x - ox, W);
+    const int z0 = std::max(min.z - oz, 0), z1 = std::min(max.z - oz, D);
+    for (int y = y0; y < y1; ++y)
+    {
+      const uint16_t around = sectionsAround(y);
+      for (int z = z0; z < z1; ++z)
+      {
+        for (int x = x0; x < x1; ++x)
+        {
+          BlockType type = blockFor(ox + x, y, oz + z);
+          if (type == BlockType::NoBlock || chunk->getBlock(x, y, z) == type)
+          {
+            continue;
+          }
+          chunk->setBlock(x, y, z, type);
+          edit.changed++;
+          edit.cells.push_back(uint16_t(Chunk::cellIndex(x, y, z)));
+          edit.sections |= around;
+          const bool lowX = x == 0, highX = x == W - 1, lowZ = z == 0, highZ = z == D - 1;
+          if (lowX) edit.border[0] |= around;
+          if (highX) edit.border[1] |= around;
+          if (lowZ) edit.border[2] |= around;
+          if (highZ) edit.border[3] |= around;
+          if (lowX && lowZ) edit.border[4] |= around;
+          if (highX && lowZ) edit.border[5] |= around;
+          if (lowX && highZ) edit.border[6] |= around;
+          if (highX && highZ) edit.border[7] |= around;
+        }
+      }
+    } });
+
+  // every block is in, now the light around the changed ones
+  auto lightStart = std::chrono::steady_clock::now();
+  std::vector<Chunk *> relit;
+  std::vector<size_t> relitEdits;
+  for (size_t i = 0; i < targets.size(); ++i)
+  {
+    if (results[i].changed != 0)
+    {
+      relit.push_back(targets[i]);
+      relitEdits.push_back(i);
+    }
+  }
+  std::vector<std::pair<Chunk *, uint16_t>> lit;
+  runLightTasks(relit, [&](LightPropagator &light, size_t r)
+                {
+    const Chunk *chunk = relit[r];
+    const int ox = chunk->chunkX * W, oz = chunk->chunkZ * D;
+    for (uint16_t cell : results[relitEdits[r]].cells)
+    {
+      light.blockChanged(ox + cell % W, (cell / W) % WorldSettings::CHUNK_HEIGHT, oz + cell / (W * WorldSettings::CHUNK_HEIGHT));
+    } }, lit);
+  if (!relit.empty())
+  {
+    stats.relights++;
+    stats.relightMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - lightStart).count();
+  }
+
+  // merge first so every chunk is queued once with everything it needs
+  std::unordered_map<Chunk *, uint16_t> remesh;
+  for (auto &[chunk, sections] : lit)
+  {
+    remesh[chunk] |= sections;
+  }
+  WorldAccessor access(*this);
+  int changed = 0;
+  for (size_t i = 0; i < targets.size(); ++i)
+  {
+    const ChunkEdit &edit = results[i];
+    if (edit.changed == 0)
+    {
+      continue;
+    }
+    changed += edit.changed;
+    Chunk *chunk = targets[i];
+    remesh[chunk] |= edit.sections;
+    const int sides[8][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}, {-1, -1}, {1, -1}, {-1, 1}, {1, 1}};
+    for (int side = 0; side < 8; ++side)
+    {
+      if (edit.border[side] == 0)
+      {
+        continue;
+      }
+      if (Chunk *next = access.chunkAt(chunk->chunkX + sides[side][0], chunk->chunkZ + sides[side][1]))
+      {
+        remesh[next] |= edit.border[side];
+      }
+    }
+  }
+  int64_t now = steadyTicks();
+  for (auto &[chunk, sections] : remesh)
+  {
+    markEdited(chunk, sections, now);
+  }
+
+  stats.blockEdits += changed;
+  stats.batchEdits++;
+  stats.batchEditMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return changed;
+}
+
+int World::fillBox(const glm::ivec3 &min, const glm::ivec3 &max, BlockType type)
+{
+  return editRegion(min, max, [type](int, int, int)
+                    { return type; });
+}
+
+int World::fillSphere(const glm::vec3 &center, float radius, BlockType type)
+{
+  const glm::ivec3 min = glm::ivec3(glm::floor(center - radius));
+  const glm::ivec3 max = glm::ivec3(glm::ceil(center + radius)) + 1;
+  const float r2 = radius * radius;
+  return editRegion(min, max, [=](int x, int y, int z)
+                    {
+    glm::vec3 d = glm::vec3(x, y, z) + 0.5f - center;
+    return glm::dot(d, d) <= r2 ? type : BlockType::NoBlock; });
+}
+
+VoxelBuffer World::copyRegion(const glm::ivec3 &min, const glm::ivec3 &max)
+{
+  VoxelBuffer buffer;
+  buffer.size = glm::max(max - min, glm::ivec3(0));
+  // whatever isn't loaded (or is above/below the world) stays NoBlock
+  buffer.blocks.assign(size_t(buffer.size.x) * buffer.size.y * buffer.size.z, BlockType::NoBlock);
+
+  const int y0 = std::max(min.y, 0), y1 = std::min(max.y, WorldSettings::CHUNK_HEIGHT);
+  std::vector<Chunk *> sources;
+  chunksInRegion(min, max, sources);
+  parallelFor(sources.size(), [&](size_t i)
+              {
+    const Chunk *chunk = sources[i];
+    const int ox = chunk->chunkX * WorldSettings::CHUNK_WIDTH, oz = chunk->chunkZ * WorldSettings::CHUNK_DEPTH;
+    const int x0 = std::max(min.x - ox, 0), x1 = std::min(max.x - ox, WorldSettings::CHUNK_WIDTH);
+    const int z0 = std::max(min.z - oz, 0), z1 = std::min(max.z - oz, WorldSettings::CHUNK_DEPTH);
+    for (int y = y0; y < y1; ++y)
+    {
+      for (int z = z0; z < z1; ++z)
+      {
+        for (int x = x0; x < x1; ++x)
         {
-          generateQueue.push(ChunkJob{exisitngChunk, JobType::BuildOnly});
-          exisitngChunk->scheduled = true;
+          buffer.at(ox + x - min.x, y - min.y, oz + z - min.z) = chunk->getBlock(x, y, z);
         }
       }
+    } });
+  return buffer;
+}
+
+int World::paste(const VoxelBuffer &buffer, const glm::ivec3 &origin, bool skipAir)
+{
+  return editRegion(origin, origin + buffer.size, [&](int x, int y, int z)
+                    {
+    BlockType type = buffer.at(x - origin.x, y - origin.y, z - origin.z);
+    return skipAir && type == BlockType::Air ? BlockType::NoBlock : type; });
+}
+
+int World::lodFor(int cx, int cz) const
+{
+  int distance = std::max(std::abs(cx - streamer.getCenterX()), std::abs(cz - streamer.getCenterZ()));
+  int level = 0;
+  for (int l = 1; l < WorldSettings::LOD_COUNT; ++l)
+  {
+    // at the default 10 chunks: 2x from 4 out, 4x from 6 and 8x for the last two rings
+    if (distance * 100 >= streamer.getRadius() * WorldSettings::LOD_START_PERCENT[l])
+    {
+      level = l;
+    }
+  }
+  return level;
+}
+
+void World::setAmbientOcclusion(bool enabled)
+{
+  if (ambientOcclusion.exchange(enabled) == enabled)
+  {
+    return;
+  }
+  for (auto &[key, chunk] : chunks)
+  {
+    if (chunk->generated.load())
+    {
+      scheduleMesh(chunk.get(), uint16_t((1u << WorldSettings::SECTION_COUNT) - 1));
+    }
+  }
+}
+
+void World::setRenderDistance(int chunks)
+{
+  chunks = std::clamp(chunks, WorldSettings::MIN_RENDER_DISTANCE, WorldSettings::MAX_RENDER_DISTANCE);
+  if (streamer.setRadius(chunks, enteringChunks, leavingChunks))
+  {
+    streamChunks();
+  }
+}
+
+float World::chunkViewDistance() const
+{
+  // the far corner of the square, with some room above it for mountains seen from high up
+  const float edge = float((streamer.getRadius() + 1) * WorldSettings::CHUNK_WIDTH);
+  return edge * 1.75f;
+}
+
+void World::updateChunkLods()
+{
+  // the rings only move when the player changes chunk, so this runs with streaming
+  for (auto &[key, chunk] : chunks)
+  {
+    int level = lodFor(key.first, key.second);
+    if (chunk->lod.load() != level)
+    {
+      chunk->lod = level;
+      scheduleMesh(chunk.get(), uint16_t((1u << WorldSettings::SECTION_COUNT) - 1));
+    }
+  }
+}
+
+void World::streamChunks()
+{
+  TRACE_ZONE("stream");
+  auto start = std::chrono::steady_clock::now();
+
+  // only the strips that entered or left the square since the last crossing
+  for (auto &[cx, cz] : leavingChunks)
+  {
+    unloadChunk(cx, cz);
+  }
+  if (!leavingChunks.empty())
+  {
+    // last frame's draw order may point at chunks that are about to be freed
+    opaqueSorter.reset();
+  }
+  for (auto &[cx, cz] : enteringChunks)
+  {
+    loadChunk(cx, cz);
+  }
+  updateChunkLods();
 
-      Chunk *chunkPtr = it->second.get();
-      if (chunkPtr->IsAabbVisible(frustumPlanes))
-      // if (true)
+  stats.streamUpdates++;
+  stats.streamMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void World::cullChunks()
+{
+  TRACE_ZONE("cull");
+  auto start = std::chrono::steady_clock::now();
+
+  visibleChunks.clear();
+  // everything in the culler is loaded, so one batched pass over it is the whole job
+  culler.cull(frustumPlanes, visibleSlots);
+  for (uint32_t slot : visibleSlots)
+  {
+    Chunk *chunk = culler.owner(slot);
+    if (chunk->hasGeometry())
+    {
+      visibleChunks.push_back(chunk);
+    }
+  }
+
+  stats.caveCulledChunks = 0;
+  if (caveCulling)
+  {
+    caveCullChunks();
+  }
+
+  stats.occludedChunks = 0;
+  if (occlusionCulling)
+  {
+    occludeChunks();
+  }
+
+  // front to back so early-Z throws away what nearer chunks already cover
+  opaqueSorter.sort(visibleChunks, playerPos);
+  stats.incrementalSorts += opaqueSorter.lastWasIncremental();
+
+  stats.visibleTriangles = 0;
+  for (Chunk *chunk : visibleChunks)
+  {
+    stats.visibleTriangles += chunk->triangleCount();
+  }
+
+  static Metrics::Histogram &cullTime = Metrics::histogram("cull ms");
+  static Metrics::Gauge &visibleGauge = Metrics::gauge("visible chunks");
+  static Metrics::Gauge &triangleGauge = Metrics::gauge("triangles");
+  const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  cullTime.record(ms);
+  visibleGauge.set(double(visibleChunks.size()));
+  triangleGauge.set(double(stats.visibleTriangles));
+
+  stats.cullFrames++;
+  stats.cullMs += ms;
+  stats.culledChunks = culler.size();
+  stats.visibleChunks = visibleChunks.size();
+}
+
+void World::caveCullChunks()
+{
+  WorldAccessor access(*this);
+  if (!cave.search(playerPos, frustumPlanes, [&](int cx, int cz) { return access.chunkAt(cx, cz); }))
+  {
+    return;
+  }
+
+  size_t kept = 0;
+  for (Chunk *chunk : visibleChunks)
+  {
+    if (cave.reached(*chunk))
+    {
+      visibleChunks[kept++] = chunk;
+    }
+  }
+  stats.caveCulledChunks = visibleChunks.size() - kept;
+  visibleChunks.resize(kept);
+}
+
+void World::occludeChunks()
+{
+  auto start = std::chrono::steady_clock::now();
+
+  int playerChunkX = int(floor(playerPos.x / WorldSettings::CHUNK_WIDTH));
+  int playerChunkZ = int(floor(playerPos.z / WorldSettings::CHUNK_DEPTH));
+  constexpr int cell = WorldSettings::OCCLUDER_CELL;
+  constexpr int cellsX = WorldSettings::CHUNK_WIDTH / cell;
+
+  // nearby terrain that is already in view becomes the occluders
+  occlusion.beginFrame(viewProjection, playerPos);
+  for (Chunk *chunk : visibleChunks)
+  {
+    if (std::abs(chunk->chunkX - playerChunkX) > WorldSettings::OCCLUDER_RADIUS ||
+        std::abs(chunk->chunkZ - playerChunkZ) > WorldSettings::OCCLUDER_RADIUS)
+    {
+      continue;
+    }
+    const glm::vec3 origin(chunk->chunkX * WorldSettings::CHUNK_WIDTH, 0.0f, chunk->chunkZ * WorldSettings::CHUNK_DEPTH);
+    const auto &heights = chunk->getOccluderHeights();
+    for (int i = 0; i < WorldSettings::OCCLUDER_CELLS; ++i)
+    {
+      if (heights[i] == 0)
       {
-        // grab the raw pointer and add it to our render list
-        visibleChunks.push_back(chunkPtr);
+        continue;
       }
+      glm::vec3 vmin = origin + glm::vec3((i % cellsX) * cell, 0.0f, (i / cellsX) * cell);
+      occlusion.addOccluder(vmin, vmin + glm::vec3(cell, heights[i], cell));
     }
   }
+  occlusion.rasterize();
+
+  // then every frustum survivor is tested against the depth buffer
+  size_t kept = 0;
+  for (Chunk *chunk : visibleChunks)
+  {
+    if (occlusion.isVisible(chunk->getBox()))
+    {
+      visibleChunks[kept++] = chunk;
+    }
+  }
+  stats.occludedChunks = visibleChunks.size() - kept;
+  visibleChunks.resize(kept);
+
+  stats.occlusionMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 }
 
 void World::uploadFinishedChunksToGPU()
 {
-  Chunk *finishedChunk = nullptr;
-  while (uploadQueue.tryPop(finishedChunk))
+  TRACE_ZONE("upload");
+  static Metrics::Histogram &uploadTime = Metrics::histogram("upload ms");
+  static Metrics::Gauge &generateDepth = Metrics::gauge("generate queue");
+  static Metrics::Gauge &uploadDepth = Metrics::gauge("upload queue");
+  static Metrics::Gauge &stagingUsed = Metrics::gauge("staging KiB");
+  generateDepth.set(double(generateQueue.size()));
+  uploadDepth.set(double(uploadQueue.size()));
+
+  auto start = std::chrono::steady_clock::now();
+  if (uploadThread.joinable())
+  {
+    // the upload thread did the GL work, only the switch over is left for here
+    publishUploads(false);
+  }
+  else
+  {
+    Chunk *finishedChunk = nullptr;
+    while (uploadQueue.tryPop(finishedChunk))
+    {
+      const bool hasMesh = !finishedChunk->generateOnly;
+      if (hasMesh && finishedChunk->unloaded)
+      {
+        finishedChunk->discardMesh();
+      }
+      else if (hasMesh)
+      {
+        uploadMesh(finishedChunk, Mesh::Slot::Live);
+      }
+      finishUpload(finishedChunk, hasMesh);
+    }
+    // fences this frame's copies and hands back the space of the ones the GPU has finished
+    staging.submit();
+  }
+  stagingUsed.set(double(staging.bytesInUse()) / 1024.0);
+  uploadTime.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+void World::uploadMesh(Chunk *chunk, Mesh::Slot slot)
+{
+  static Metrics::Counter &uploadBytes = Metrics::counter("upload bytes");
+  static Metrics::Counter &stagingFallbacks = Metrics::counter("staging fallbacks");
+  // the upload hands the mesh over, count it first
+  uploadBytes.add(int64_t(chunk->meshBytes()));
+  // the ring was full (or the mesh bigger than it), this one goes through the driver
+  if (staging.active() && !chunk->meshVertices().empty())
+  {
+    stagingFallbacks.add();
+  }
+  // a Live upload is drawn from straight away, Pending waits for publishUploads
+  if (slot == Mesh::Slot::Live)
+  {
+    chunk->setData();
+  }
+  else
+  {
+    chunk->uploadMesh(slot);
+  }
+}
+
+void World::finishUpload(Chunk *chunk, bool hasMesh)
+{
+  chunk->generateOnly = false;
+  if (hasMesh && !chunk->unloaded)
   {
-    finishedChunk->setData();
+    // the new mesh comes with tighter y bounds
+    culler.update(chunk->cullSlot, chunk->getBox());
+
+    // uploads happen before the draw in the same frame, so this is edit-to-visible
+    if (int64_t editTicks = chunk->meshedEditTicks())
+    {
+      double ms = double(steadyTicks() - editTicks) / 1e6;
+      stats.editRemeshes++;
+      stats.editLatencyMs += ms;
+      stats.maxEditLatencyMs = std::max(stats.maxEditLatencyMs, ms);
+    }
+  }
+  // cleared here rather than on the worker so an unloaded chunk is never freed while queued
+  chunk->scheduled = false;
+  if (chunk->prefetched)
+  {
+    // generated and waiting for the square to reach it
+    return;
+  }
+  // asked for another mesh (an edit or a new LOD) while this one was being built
+  if (chunk->dirtySections.load() != 0 && !chunk->unloaded)
+  {
+    scheduleMesh(chunk, 0, chunk->remeshPriority);
+  }
+  else
+  {
+    chunk->remeshPriority = QueuePriority::Normal;
+  }
+}
+
+bool World::startUploadThread(std::function<void(bool)> bindContext)
+{
+  if (uploadThread.joinable() || !bindContext)
+  {
+    return false;
+  }
+  uploadContext = std::move(bindContext);
+  uploadThread = std::thread(&World::uploadThreadLoop, this);
+  return true;
+}
+
+void World::stopUploadThread()
+{
+  if (!uploadThread.joinable())
+  {
+    return;
+  }
+  // ahead of any chunk still queued, those are uploaded here from the next frame on
+  uploadQueue.push(nullptr, QueuePriority::High);
+  uploadThread.join();
+  publishUploads(true);
+}
+
+void World::uploadThreadLoop()
+{
+  Trace::setThreadName("upload");
+  static Metrics::Histogram &batchTime = Metrics::histogram("upload batch ms");
+  uploadContext(true);
+  bool stopping = false;
+  while (!stopping)
+  {
+    Chunk *chunk = uploadQueue.pop();
+    // stopUploadThread's marker, or the world is going away
+    if (chunk == nullptr)
+    {
+      break;
+    }
+    TRACE_ZONE("upload batch");
+    auto start = std::chrono::steady_clock::now();
+    auto batch = std::make_unique<UploadBatch>();
+    do
+    {
+      // unloaded isn't ours to read, an unloaded chunk's mesh is just never published
+      if (!chunk->generateOnly)
+      {
+        uploadMesh(chunk, Mesh::Slot::Pending);
+      }
+      batch->chunks.push_back(chunk);
+      if (!uploadQueue.tryPop(chunk))
+      {
+        break;
+      }
+      stopping = chunk == nullptr;
+    } while (!stopping);
+    staging.submit();
+    batch->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // or the fence might never reach the GPU, nothing else flushes this context
+    glFlush();
+    batchTime.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+    // onto the front of the published list, the render thread takes the whole list in one exchange
+    UploadBatch *published = batch.release();
+    published->next = publishedBatches.load();
+    while (!publishedBatches.compare_exchange_weak(published->next, published))
+    {
+    }
   }
+  uploadContext(false);
+}
+
+void World::publishUploads(bool wait)
+{
+  // newest first as it comes off the list, flipped back into upload order
+  std::vector<std::unique_ptr<UploadBatch>> taken;
+  for (UploadBatch *batch = publishedBatches.exchange(nullptr); batch != nullptr; batch = batch->next)
+  {
+    taken.emplace_back(batch);
+  }
+  for (auto it = taken.rbegin(); it != taken.rend(); ++it)
+  {
+    uploadedBatches.push_back(std::move(*it));
+  }
+
+  while (!uploadedBatches.empty())
+  {
+    UploadBatch &batch = *uploadedBatches.front();
+    // in order, a batch is never published ahead of an earlier one
+    const GLenum status = glClientWaitSync(batch.fence, 0, wait ? GLuint64(1000000000) : 0);
+    if (status == GL_TIMEOUT_EXPIRED && wait)
+    {
+      continue;
+    }
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+    {
+      break;
+    }
+    glDeleteSync(batch.fence);
+    for (Chunk *chunk : batch.chunks)
+    {
+      const bool hasMesh = !chunk->generateOnly;
+      if (hasMesh && !chunk->unloaded)
+      {
+        chunk->publishMesh();
+      }
+      finishUpload(chunk, hasMesh);
+    }
+    uploadedBatches.pop_front();
+  }
+}
+
+uint64_t World::oldestPinnedEpoch() const
+{
+  uint64_t oldest = std::numeric_limits<uint64_t>::max();
+  for (const std::atomic<uint64_t> &pin : pinnedEpochs)
+  {
+    uint64_t epoch = pin.load();
+    if (epoch != 0)
+    {
+      oldest = std::min(oldest, epoch);
+    }
+  }
+  return oldest;
+}
+
+void World::releaseRetiredChunks()
+{
+  if (retiredChunks.empty())
+  {
+    return;
+  }
+  // an accessor that started before the unload may still have the pointer cached
+  const uint64_t oldest = oldestPinnedEpoch();
+  std::erase_if(retiredChunks, [oldest](const std::unique_ptr<Chunk> &chunk)
+                { return !chunk->scheduled.load() && chunk->retiredEpoch <= oldest; });
+}
+
+void World::runLightTasks(const std::vector<Chunk *> &targets, const std::function<void(LightPropagator &, size_t)> &work,
+                          std::vector<std::pair<Chunk *, uint16_t>> &touched)
+{
+  // a propagator stays inside the 3x3 chunks around its target, so targets three apart on both
+  // axes never share a chunk. each of the nine colours is one parallel pass
+  std::array<std::vector<size_t>, 9> colours;
+  for (size_t i = 0; i < targets.size(); ++i)
+  {
+    const int rx = ((targets[i]->chunkX % 3) + 3) % 3, rz = ((targets[i]->chunkZ % 3) + 3) % 3;
+    colours[rx + 3 * rz].push_back(i);
+  }
+  std::vector<std::vector<std::pair<Chunk *, uint16_t>>> results(targets.size());
+  for (const std::vector<size_t> &colour : colours)
+  {
+    parallelFor(colour.size(), [&](size_t k)
+                {
+      const size_t i = colour[k];
+      LightPropagator light(*this, targets[i]->chunkX, targets[i]->chunkZ);
+      work(light, i);
+      light.run();
+      light.collectTouched(results[i]); });
+  }
+  for (const auto &result : results)
+  {
+    touched.insert(touched.end(), result.begin(), result.end());
+  }
+}
+
+void World::stitchLight()
+{
+  TRACE_ZONE("light stitch");
+  // a chunk is ready once its worker has generated and lit it
+  std::vector<Chunk *> ready;
+  std::erase_if(unstitchedChunks, [&](Chunk *chunk)
+                {
+    if (!chunk->generated.load())
+    {
+      return false;
+    }
+    ready.push_back(chunk);
+    return true; });
+  if (ready.empty())
+  {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::pair<Chunk *, uint16_t>> touched;
+  runLightTasks(ready, [](LightPropagator &light, size_t)
+                { light.stitchCentre(); }, touched);
+  // a neighbour meshed before this chunk was generated saw air across the border, its border
+  // faces and their corner shading have to be redone
+  WorldAccessor access(*this);
+  for (Chunk *chunk : ready)
+  {
+    for (int dz = -1; dz <= 1; dz++)
+    {
+      for (int dx = -1; dx <= 1; dx++)
+      {
+        Chunk *next = access.chunkAt(chunk->chunkX + dx, chunk->chunkZ + dz);
+        if (next == nullptr || next == chunk || !next->generated.load() ||
+            (next->meshedNeighbours.load() & (1u << Chunk::neighbourBit(-dx, -dz))))
+        {
+          continue;
+        }
+        touched.emplace_back(next, uint16_t((1u << WorldSettings::SECTION_COUNT) - 1));
+        stats.borderRemeshes++;
+      }
+    }
+  }
+  for (auto &[chunk, sections] : touched)
+  {
+    scheduleMesh(chunk, sections);
+  }
+  stats.lightStitches += int(ready.size());
+  stats.lightStitchMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void World::updateFarTerrain()
+{
+  TRACE_ZONE("far terrain");
+  // the outer ring of chunks may still be loading, so only cut the far field out one chunk inside it
+  const int r = streamer.getRadius() - 1;
+  const glm::vec2 holeMin((streamer.getCenterX() - r) * WorldSettings::CHUNK_WIDTH,
+                          (streamer.getCenterZ() - r) * WorldSettings::CHUNK_DEPTH);
+  const glm::vec2 holeMax((streamer.getCenterX() + r + 1) * WorldSettings::CHUNK_WIDTH,
+                          (streamer.getCenterZ() + r + 1) * WorldSettings::CHUNK_DEPTH);
+  stats.farLevelUpdates += farTerrain.update(playerPos, holeMin, holeMax);
+}
+
+void World::drawFarTerrain(const glm::mat4 &farViewProjection, const glm::vec3 &cameraPos)
+{
+  farTerrain.draw(farViewProjection, cameraPos);
 }
 
 void World::drawVisibleChunks(Shader &shader)
 {
-  std::cout << visibleChunks.size() << std::endl;
+  TRACE_ZONE("draw");
+  static Metrics::Histogram &drawTime = Metrics::histogram("draw ms");
+  static Metrics::Gauge &drawCalls = Metrics::gauge("draw calls");
+  auto start = std::chrono::steady_clock::now();
+  LOG_DEBUG(visibleChunks.size() << " chunks visible");
+  // every chunk shares the shader and the atlas, so bind them once for the whole list
+  shader.use();
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, atlasText);
   for (auto &chunk : visibleChunks)
   {
-    chunk->draw(shader, atlasText);
+    chunk->draw(shader);
   }
+  glBindVertexArray(0);
+  // one glDrawElements per chunk, cullChunks only keeps chunks with geometry
+  drawCalls.set(double(visibleChunks.size()));
+  // cpu side, submitting the calls not the gpu executing them
+  drawTime.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
 }
 
-void World::updatePlayerPos(const glm::vec3 &newPos, const std::vector<glm::vec4> &newFrustumPlanes)
+void World::updatePlayerPos(const glm::vec3 &newPos, const std::vector<glm::vec4> &newFrustumPlanes, const glm::mat4 &newViewProjection)
 {
   oldPos = playerPos;
   this->playerPos = newPos;
-  if (newFrustumPlanes != frustumPlanes)
-  {
-    frustumPlanes = newFrustumPlanes;
-    frustumDirty = true;
-  }
-  int oldChunkX = int(floor(oldPos.x / WorldSettings::CHUNK_WIDTH));
-  int oldChunkZ = int(floor(oldPos.z / WorldSettings::CHUNK_DEPTH));
+  frustumPlanes = newFrustumPlanes;
+  viewProjection = newViewProjection;
+
   int newChunkX = int(floor(playerPos.x / WorldSettings::CHUNK_WIDTH));
   int newChunkZ = int(floor(playerPos.z / WorldSettings::CHUNK_DEPTH));
-  bool moved = (oldChunkX != newChunkX || oldChunkZ != newChunkZ);
-  if (moved || frustumDirty)
+  if (streamer.recenter(newChunkX, newChunkZ, enteringChunks, leavingChunks))
   {
-    updateVisibleChunks();
-    frustumDirty = false;
+    streamChunks();
   }
+  prefetchChunks();
 }
 
 void World::workerThreadPool()
 {
+  Trace::setThreadName("worker");
+  static Metrics::Histogram &generateTime = Metrics::histogram("generate ms");
+  static Metrics::Histogram &lightTime = Metrics::histogram("light ms");
+  static Metrics::Histogram &meshTime = Metrics::histogram("mesh ms");
+  static Metrics::Counter &chunksGenerated = Metrics::counter("chunks generated");
+  static Metrics::Counter &meshesBuilt = Metrics::counter("meshes built");
   while (true)
   {
-    ChunkJob job = generateQueue.pop();
+    ChunkJob job;
+    {
+      TRACE_ZONE("queue wait");
+      job = generateQueue.pop();
+    }
+    if (job.type == JobType::Task && job.task)
+    {
+      TRACE_ZONE("task");
+      job.task();
+      continue;
+    }
     if (job.chunk == nullptr)
     {
       break;
     }
     Chunk *c = job.chunk;
-    c->dirty = false;
+    if (job.type == JobType::Prefetch)
+    {
+      if (!c->prefetchCancelled.load())
+      {
+        c->generate();
+        LightPropagator::lightChunk(*c);
+        c->generated = true;
+      }
+      // back through the upload queue so the render thread knows the job is done
+      uploadQueue.push(c);
+      continue;
+    }
     if (job.type == JobType::GenerateAndBuild)
     {
+      auto start = std::chrono::steady_clock::now();
       c->generate();
+      auto generated = std::chrono::steady_clock::now();
+      // before generated is set, nothing else writes a chunk's light until then
+      LightPropagator::lightChunk(*c);
+      c->generated = true;
+      generateTime.record(std::chrono::duration<double, std::milli>(generated - start).count());
+      lightTime.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - generated).count());
+      chunksGenerated.add();
     }
+    auto meshStart = std::chrono::steady_clock::now();
     c->buildMesh();
-    c->scheduled = false;
+    meshTime.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - meshStart).count());
+    meshesBuilt.add();
     uploadQueue.push(c);
   }
 }
@@ -168,23 +1406,23 @@ void World::startWorldThreads()
   }
 }
 
-void World::manageChunks(const glm::vec3 &newPos, Shader &shader, const std::vector<glm::vec4> &frustumPlanes)
+void World::manageChunks(const glm::vec3 &newPos, Shader &shader, const std::vector<glm::vec4> &frustumPlanes, const glm::mat4 &viewProjection)
 {
-  updatePlayerPos(newPos, frustumPlanes);
-  uploadFinishedChunksToGPU();
+  updateChunks(newPos, frustumPlanes, viewProjection);
   drawVisibleChunks(shader);
 }
 
+void World::updateChunks(const glm::vec3 &newPos, const std::vector<glm::vec4> &frustumPlanes, const glm::mat4 &viewProjection)
+{
+  updatePlayerPos(newPos, frustumPlanes, viewProjection);
+  updateFarTerrain();
+  stitchLight();
+  uploadFinishedChunksToGPU();
+  releaseRetiredChunks();
+  cullChunks();
+}
+
 void World::init_noise()
 {
-  noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2S);
-  noise.SetSeed(WorldSettings::seed);
-  noise.SetFractalType(FastNoiseLite::FractalType_FBm);
-  noise.SetFrequency(0.01);
-  noise.SetFractalOctaves(9);
-  noise.SetFractalLacunarity(1.5);
-  noise.SetFractalGain(0.02);
-  noise.SetFrequency(0.007);
-  noise.SetDomainWarpType(FastNoiseLite::DomainWarpType_OpenSimplex2);
-  noise.SetDomainWarpAmp(50.0);
+  Chunk::setupNoise(noise, WorldSettings::seed);
 }
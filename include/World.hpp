@@ -1,35 +1,166 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <vector>
+#include <deque>
 #include <unordered_map>
 #include <memory>
+#include <shared_mutex>
 #include <thread>
+#include <functional>
 #include "VoxelTypes.hpp" // for BlockType, etc.
 #include "SafeQueue.hpp"  // for SafeQueue<ChunkJob>
 #include "shader_m.h"     // for Shader
 #include "Chunk.hpp"
+#include "StagingRing.hpp"
+#include "ChunkStreamer.hpp"
+#include "ChunkPrefetcher.hpp"
+#include "FrustumCuller.hpp"
+#include "OcclusionCuller.hpp"
+#include "CaveCuller.hpp"
+#include "DrawSorter.hpp"
+#include "FarTerrain.hpp"
 #include "FastNoiseLite.h"
 #include "camera.h"
 
 class Chunk;
+class WorldAccessor;
+class LightPropagator;
 
 struct PairHash;
 
+// streaming and culling are timed separately so we can see which one a frame pays for
+struct WorldStats
+{
+    int streamUpdates = 0;     // chunk-boundary crossings handled
+    int chunksLoaded = 0;
+    int chunksUnloaded = 0;
+    double streamMs = 0.0;
+
+    int cullFrames = 0;
+    double cullMs = 0.0;
+    size_t culledChunks = 0;   // loaded chunks tested on the last frame
+    size_t visibleChunks = 0;  // survivors on the last frame
+    size_t visibleTriangles = 0;
+    size_t caveCulledChunks = 0; // in the frustum but not reachable through open sections
+    size_t occludedChunks = 0;  // passed the frustum but hidden behind nearer terrain
+    double occlusionMs = 0.0;   // part of cullMs
+    int incrementalSorts = 0;   // frames where last frame's draw order only needed touching up
+
+    int farLevelUpdates = 0;    // far terrain levels re-sampled after the camera moved
+
+    int blockEdits = 0;
+    int editRemeshes = 0;       // uploads that carried at least one edit
+    double editLatencyMs = 0.0; // summed over editRemeshes, from the edit to the upload before the draw
+    double maxEditLatencyMs = 0.0;
+    int batchEdits = 0;         // fillBox/fillSphere/paste calls
+    double batchEditMs = 0.0;   // writing the blocks and relighting, the remeshes are on the workers
+
+    int borderRemeshes = 0;     // chunks meshed before a neighbour was generated and meshed again after
+    int lightStitches = 0;      // new chunks whose light was joined up with their neighbours
+    double lightStitchMs = 0.0;
+    int relights = 0;           // edits (single blocks or batches) that relit the area around them
+    double relightMs = 0.0;     // part of batchEditMs for batches
+};
+
 class World
 {
 public:
     World();
     ~World();
 
-    void manageChunks(const glm::vec3 &newPos, Shader &shader, const std::vector<glm::vec4> &frustumPlanes);
-    BlockType getChunk(int nChunkX, int nChunkZ, int tx, int ty, int tz);
+    // updateChunks then drawVisibleChunks, for callers that don't need to time the two apart
+    void manageChunks(const glm::vec3 &newPos, Shader &shader, const std::vector<glm::vec4> &frustumPlanes, const glm::mat4 &viewProjection);
+    // the frame's CPU side: streaming, light stitching, finished meshes uploaded, culling
+    void updateChunks(const glm::vec3 &newPos, const std::vector<glm::vec4> &frustumPlanes, const glm::mat4 &viewProjection);
+    // only the draw calls for what the last updateChunks left visible
+    void drawVisibleChunks(Shader &shader);
+    // draws the horizon past the loaded chunks, call it before the chunk draws and clear depth in between
+    void drawFarTerrain(const glm::mat4 &farViewProjection, const glm::vec3 &cameraPos);
+    // world block coordinates. only the touched section (and the ones across a border it sits on)
+    // is remeshed, ahead of streaming work. false if the chunk isn't loaded and generated yet
+    bool setBlock(int x, int y, int z, BlockType type);
+    BlockType getBlock(int x, int y, int z);
+
+    // bulk edits over [min, max). blocks are written per chunk in parallel on the worker pool and
+    // every touched section is queued for one remesh. return how many blocks changed
+    int fillBox(const glm::ivec3 &min, const glm::ivec3 &max, BlockType type);
+    int fillSphere(const glm::vec3 &center, float radius, BlockType type);
+    VoxelBuffer copyRegion(const glm::ivec3 &min, const glm::ivec3 &max);
+    // skipAir leaves the world alone where the buffer holds air, for pasting structures
+    int paste(const VoxelBuffer &buffer, const glm::ivec3 &origin, bool skipAir = false);
+
+    // first solid block along the ray. unloaded chunks and empty sections are crossed in one step
+    RayHit raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance);
+    // many rays at once, spread over the worker pool. hits[i] answers rays[i]
+    void raycast(const std::vector<Ray> &rays, std::vector<RayHit> &hits);
+
+    // runs body(0..count-1) on the workers and the calling thread, returns once all are done
+    void parallelFor(size_t count, const std::function<void(size_t)> &body);
+
+    // loaded chunks still waiting on a worker or an upload
+    size_t pendingChunks() const;
+
+    const WorldStats &getStats() const { return stats; }
+    void resetStats() { stats = WorldStats{}; }
+    void setOcclusionCulling(bool enabled) { occlusionCulling = enabled; }
+    void setCaveCulling(bool enabled) { caveCulling = enabled; }
+    // corner shading on full resolution meshes, switching it remeshes every loaded chunk
+    void setAmbientOcclusion(bool enabled);
+    bool ambientOcclusionEnabled() const { return ambientOcclusion.load(); }
+    // chunks loaded in each direction, clamped to [MIN_RENDER_DISTANCE, MAX_RENDER_DISTANCE].
+    // only the ring between the old and new square is loaded or unloaded
+    void setRenderDistance(int chunks);
+    int renderDistance() const { return streamer.getRadius(); }
+    // far plane for the chunk pass that just covers the loaded square
+    float chunkViewDistance() const;
+    // generating chunks ahead of a moving camera while the workers are idle, on by default.
+    // switching it off drops whatever was prefetched
+    void setPrefetching(bool enabled);
+    bool prefetchingEnabled() const { return prefetching; }
+
+    // prefetched chunks kept at once, and queued per frame
+    static constexpr size_t PREFETCH_LIMIT = 192;
+    static constexpr int PREFETCH_PER_FRAME = 8;
+
+    // where the workers put finished meshes for the render thread to copy, inactive without GL 4.4
+    StagingRing &stagingRing() { return staging; }
+
+    // moves mesh uploads off the render thread onto one of their own, which needs a second context
+    // sharing objects with the render thread's. bindContext(true) makes it current on the calling
+    // thread and bindContext(false) lets go of it, both are called from the upload thread. the
+    // render thread only swaps finished meshes in after that. false if it is already running
+    bool startUploadThread(std::function<void(bool)> bindContext);
+    // waits for the thread and switches to whatever it had uploaded. call it while the other context
+    // is still alive, the destructor does too
+    void stopUploadThread();
+    bool uploadThreadRunning() const { return uploadThread.joinable(); }
+
+    // threads that may hold a WorldAccessor at the same time, making one on another thread aborts
+    static constexpr int MAX_ACCESSOR_THREADS = 64;
 
 private:
+    friend class WorldAccessor;
+
     // Internal pipeline stages:
-    void updatePlayerPos(const glm::vec3 &newPos, const std::vector<glm::vec4> &newFrustumPlanes);
-    void updateVisibleChunks();
+    void updatePlayerPos(const glm::vec3 &newPos, const std::vector<glm::vec4> &newFrustumPlanes, const glm::mat4 &newViewProjection);
+    void streamChunks();
+    void cullChunks();
+    void caveCullChunks();
+    void occludeChunks();
     void uploadFinishedChunksToGPU();
-    void drawVisibleChunks(Shader &shader);
+    // the GL half of taking in a finished chunk, Live on the render thread or Pending on the upload thread
+    void uploadMesh(Chunk *chunk, Mesh::Slot slot);
+    // the rest of it, render thread: culling box, edit latency, the chunk's next job
+    void finishUpload(Chunk *chunk, bool hasMesh);
+    void uploadThreadLoop();
+    // switches to the meshes of every upload batch whose fence has signalled, all of them if wait
+    void publishUploads(bool wait);
+    void releaseRetiredChunks();
+    void stitchLight();
+    void updateFarTerrain();
+    void prefetchChunks();
 
     // Worker threads:
     void startWorldThreads();
@@ -37,20 +168,89 @@ private:
     void workerThreadPool();
 
     // Utility:
+    void loadChunk(int cx, int cz);
+    void unloadChunk(int cx, int cz);
+    // drops a chunk from the prefetch cache, returns it to the retired list until its job is done
+    void dropPrefetched(std::unique_ptr<Chunk> chunk);
+    void scheduleMesh(Chunk *chunk, uint16_t sections, QueuePriority priority = QueuePriority::Normal);
+    // queues the remesh for an edit, ticks is when it happened
+    void markEdited(Chunk *chunk, uint16_t sections, int64_t ticks);
+    // blockFor(x, y, z) gives the new block at a world position inside [min, max), NoBlock to leave it
+    int editRegion(const glm::ivec3 &min, const glm::ivec3 &max, const std::function<BlockType(int, int, int)> &blockFor);
+    // runs work(propagator, i) and then the propagator for every target, each on the 3x3 chunks
+    // around targets[i]. touched gets the sections whose light changed
+    void runLightTasks(const std::vector<Chunk *> &targets, const std::function<void(LightPropagator &, size_t)> &work,
+                       std::vector<std::pair<Chunk *, uint16_t>> &touched);
+    // generated chunks overlapping [min, max), chunk coordinates in the same order
+    void chunksInRegion(const glm::ivec3 &min, const glm::ivec3 &max, std::vector<Chunk *> &out);
+    int lodFor(int cx, int cz) const;
+    void updateChunkLods();
+    RayHit castRay(WorldAccessor &access, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance);
+    // smallest epoch any accessor has pinned, chunks retired at or before it are safe to free
+    uint64_t oldestPinnedEpoch() const;
 
     // Data:
     glm::vec3 playerPos, oldPos;
-    bool frustumDirty = false;
     std::vector<glm::vec4> frustumPlanes;
+    glm::mat4 viewProjection{1.0f};
 
+    // workers look chunks up through a WorldAccessor, the render thread is the only writer
+    std::shared_mutex chunksMutex;
     std::unordered_map<std::pair<int, int>, std::unique_ptr<Chunk>, PairHash> chunks;
+    // unloaded chunks wait here until no worker, upload or accessor still holds them
+    std::vector<std::unique_ptr<Chunk>> retiredChunks;
+    // bumped by every unload. each thread with a live accessor keeps the epoch it started at
+    // in its slot (0 when it has none), see WorldAccessor
+    std::atomic<uint64_t> chunkEpoch{1};
+    std::array<std::atomic<uint64_t>, MAX_ACCESSOR_THREADS> pinnedEpochs{};
     std::vector<Chunk *> visibleChunks;
+    // loaded chunks whose light still has to be stitched to the neighbours
+    std::vector<Chunk *> unstitchedChunks;
+
+    ChunkStreamer streamer{WorldSettings::RENDER_DISTANCE};
+    std::vector<std::pair<int, int>> enteringChunks, leavingChunks;
+    // generated ahead of the square, loadChunk takes them from here. never visible to the workers'
+    // accessors, nothing outside the render thread looks at this map
+    ChunkPrefetcher prefetcher;
+    std::unordered_map<std::pair<int, int>, std::unique_ptr<Chunk>, PairHash> prefetchedChunks;
+    std::vector<std::pair<int, int>> predictedChunks;
+    bool prefetching = true;
+    FrustumCuller culler;
+    std::vector<uint32_t> visibleSlots;
+    OcclusionCuller occlusion;
+    bool occlusionCulling = true;
+
+    CaveCuller cave;
+    bool caveCulling = true;
+    // read by the workers while they mesh
+    std::atomic<bool> ambientOcclusion{true};
+
+    DrawSorter opaqueSorter{SortOrder::FrontToBack};
 
     SafeQueue<ChunkJob> generateQueue;
     SafeQueue<Chunk *> uploadQueue;
+    StagingRing staging;
     std::vector<std::thread> threads;
 
+    // what the upload thread hands over: the chunks it uploaded and a fence behind their uploads
+    struct UploadBatch
+    {
+        GLsync fence = nullptr;
+        std::vector<Chunk *> chunks;
+        UploadBatch *next = nullptr;
+    };
+    std::thread uploadThread;
+    std::function<void(bool)> uploadContext;
+    // pushed by the upload thread, newest first. the render thread takes all of it at once
+    std::atomic<UploadBatch *> publishedBatches{nullptr};
+    // taken but not signalled yet, oldest first (render thread only)
+    std::deque<std::unique_ptr<UploadBatch>> uploadedBatches;
+
     GLuint atlasText;
 
     FastNoiseLite noise;
-};
\ No newline at end of file
+    // after the queue and the noise, its fills run on the workers with both
+    FarTerrain farTerrain{noise, generateQueue};
+
+    WorldStats stats;
+};
@@ -0,0 +1,87 @@
+#include "WorldAccessor.hpp"
+#include "World.hpp"
+#include "Log.hpp"
+#include <cstdlib>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+namespace
+{
+  // every thread that makes accessors gets a slot index, handed back when the thread exits
+  std::mutex slotMutex;
+  std::vector<int> freeSlots;
+  int nextSlot = 0;
+
+  struct ThreadSlot
+  {
+    int index;
+
+    ThreadSlot()
+    {
+      std::lock_guard<std::mutex> lock(slotMutex);
+      if (freeSlots.empty())
+      {
+        index = nextSlot++;
+      }
+      else
+      {
+        index = freeSlots.back();
+        freeSlots.pop_back();
+      }
+    }
+
+    ~ThreadSlot()
+    {
+      std::lock_guard<std::mutex> lock(slotMutex);
+      freeSlots.push_back(index);
+    }
+  };
+
+  thread_local ThreadSlot threadSlot;
+}
+
+WorldAccessor::WorldAccessor(World &world)
+    : world(world), slot(threadSlot.index)
+{
+  if (slot >= World::MAX_ACCESSOR_THREADS)
+  {
+    // past the end of pinnedEpochs. not just a debug check, in a release build the epoch would be
+    // written over whatever follows the table and the chunks it protects freed under us
+    LOG_ERROR("more than " << World::MAX_ACCESSOR_THREADS << " threads made world accessors at once");
+    std::abort();
+  }
+  // an accessor further up this thread's stack already holds an older (or the same) epoch
+  std::atomic<uint64_t> &pin = world.pinnedEpochs[slot];
+  if (pin.load() == 0)
+  {
+    pin.store(world.chunkEpoch.load());
+    pinned = true;
+  }
+}
+
+WorldAccessor::~WorldAccessor()
+{
+  if (pinned)
+  {
+    world.pinnedEpochs[slot].store(0);
+  }
+}
+
+Chunk *WorldAccessor::resolve(int cx, int cz)
+{
+  Chunk *chunk = nullptr;
+  {
+    // workers come through here while the render thread loads and unloads
+    std::shared_lock<std::shared_mutex> lock(world.chunksMutex);
+    auto it = world.chunks.find(std::make_pair(cx, cz));
+    if (it != world.chunks.end())
+    {
+      chunk = it->second.get();
+    }
+  }
+  Entry &entry = cache[nextEntry];
+  nextEntry = (nextEntry + 1) % CACHE_SIZE;
+  entry = Entry{cx, cz, chunk};
+  return chunk;
+}
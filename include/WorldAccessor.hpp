@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <climits>
+#include <cstddef>
+#include "Chunk.hpp"
+#include "VoxelTypes.hpp"
+#include "WorldConfig.hpp"
+
+class World;
+
+/*
+    Block queries in world coordinates for code that reads lots of blocks
+    close together: the mesher looking across a chunk border, raycasts,
+    collision. The last CACHE_SIZE columns it resolved are remembered, so
+    only a query that lands in a new column takes the map's lock and hashes
+    a key. World to chunk and world to local coordinates are a shift and a
+    mask (see WorldSettings::CHUNK_SHIFT).
+
+    While an accessor is alive its thread pins the world's unload epoch and
+    chunks unloaded after that stay in the retired list, so a cached pointer
+    never dangles. It can go stale though (the column may have been unloaded
+    since), and an accessor that lives forever keeps retired chunks from
+    ever being freed. Make one per job, per tick or per batch.
+*/
+class WorldAccessor
+{
+    public:
+    static constexpr int CACHE_SIZE = 4;
+
+    explicit WorldAccessor(World& world);
+    ~WorldAccessor();
+
+    WorldAccessor(const WorldAccessor&) = delete;
+    WorldAccessor& operator=(const WorldAccessor&) = delete;
+
+    static int chunkCoord(int block) { return block >> WorldSettings::CHUNK_SHIFT; }
+    static int localCoord(int block) { return block & WorldSettings::CHUNK_MASK; }
+
+    // loaded chunk or nullptr, generated or not
+    Chunk* chunkAt(int cx, int cz)
+    {
+        for (const Entry& entry : cache)
+        {
+            if (entry.x == cx && entry.z == cz)
+            {
+                return entry.chunk;
+            }
+        }
+        return resolve(cx, cz);
+    }
+
+    // NoBlock above or below the world and in chunks that aren't loaded and generated
+    BlockType getBlock(int x, int y, int z)
+    {
+        Chunk* chunk = generatedChunk(x, y, z);
+        return chunk == nullptr ? BlockType::NoBlock : chunk->blockAt(localIndex(x, y, z));
+    }
+
+    // raw write like Chunk::setBlock, remeshing is up to the caller. false where getBlock gives NoBlock
+    bool setBlock(int x, int y, int z, BlockType type)
+    {
+        Chunk* chunk = generatedChunk(x, y, z);
+        if (chunk == nullptr)
+        {
+            return false;
+        }
+        chunk->setBlock(localCoord(x), y, localCoord(z), type);
+        return true;
+    }
+
+    private:
+    struct Entry
+    {
+        int x = INT_MIN;
+        int z = INT_MIN;
+        Chunk* chunk = nullptr;
+    };
+
+    Chunk* generatedChunk(int x, int y, int z)
+    {
+        if (y < 0 || y >= WorldSettings::CHUNK_HEIGHT)
+        {
+            return nullptr;
+        }
+        Chunk* chunk = chunkAt(chunkCoord(x), chunkCoord(z));
+        return chunk != nullptr && chunk->generated.load() ? chunk : nullptr;
+    }
+
+    // same layout as Chunk::index
+    static size_t localIndex(int x, int y, int z)
+    {
+        return size_t(localCoord(x)) + WorldSettings::CHUNK_WIDTH * (size_t(y) + WorldSettings::CHUNK_HEIGHT * size_t(localCoord(z)));
+    }
+
+    // cache miss: looks the column up in the world's map and remembers it, misses included
+    Chunk* resolve(int cx, int cz);
+
+    World& world;
+    std::array<Entry, CACHE_SIZE> cache{};
+    int nextEntry = 0;
+    // this thread's slot in World::pinnedEpochs, and whether we are the one that pinned it
+    int slot;
+    bool pinned = false;
+};
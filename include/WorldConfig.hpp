@@ -21,9 +21,39 @@ struct WorldSettings
     static constexpr int CHUNK_HEIGHT = 256;
     static constexpr int CHUNK_DEPTH = 16;
     static constexpr int CHUNK_SIZE = CHUNK_WIDTH * CHUNK_HEIGHT * CHUNK_DEPTH;
+    // world block -> chunk is a shift and block -> local a mask, so width and depth stay powers of two
+    static constexpr int CHUNK_SHIFT = 4;
+    static constexpr int CHUNK_MASK = (1 << CHUNK_SHIFT) - 1;
+    // chunks are split vertically into 16-high sections for bounds and remeshing
+    static constexpr int SECTION_HEIGHT = 16;
+    static constexpr int SECTION_COUNT = CHUNK_HEIGHT / SECTION_HEIGHT;
+    // occlusion: each chunk is reduced to solid boxes over OCCLUDER_CELL x OCCLUDER_CELL columns,
+    // and only chunks within OCCLUDER_RADIUS of the player are drawn into the depth buffer
+    static constexpr int OCCLUDER_CELL = 4;
+    static constexpr int OCCLUDER_CELLS = (CHUNK_WIDTH / OCCLUDER_CELL) * (CHUNK_DEPTH / OCCLUDER_CELL);
+    static constexpr int OCCLUDER_RADIUS = 4;
     static constexpr int MAX_SURFACE = 34;
+    // chunks loaded in each direction around the player's chunk
+    static constexpr int RENDER_DISTANCE = 10;
+    // what the adaptive render distance may pick from
+    static constexpr int MIN_RENDER_DISTANCE = 4;
+    static constexpr int MAX_RENDER_DISTANCE = 24;
+    // level of detail n (cells of 2^n blocks) starts LOD_START_PERCENT[n] percent of the render
+    // distance away from the player, so the coarsest level covers the outer rings at any radius
+    static constexpr int LOD_COUNT = 4;
+    static constexpr int LOD_START_PERCENT[LOD_COUNT] = {0, 35, 60, 85};
+    // how far in blocks the border walls of a LOD mesh hang down to cover seams
+    static constexpr int LOD_SKIRT_DEPTH = 8;
+    // far terrain past the chunks: FAR_LEVELS clipmap levels, vertices FAR_SPACING blocks
+    // apart on the innermost one and twice as far apart on each level after it
+    static constexpr int FAR_LEVELS = 5;
+    static constexpr int FAR_SPACING = 8;
     static constexpr int SCR_WIDTH = 1200;
     static constexpr int SCR_HEIGHT = 800;
 };
 
+static_assert(WorldSettings::CHUNK_WIDTH == 1 << WorldSettings::CHUNK_SHIFT &&
+              WorldSettings::CHUNK_DEPTH == 1 << WorldSettings::CHUNK_SHIFT,
+              "chunk width and depth must both be 1 << CHUNK_SHIFT");
+
 #define CONFIG WorldSettings::instance()
\ No newline at end of file
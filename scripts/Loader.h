@@ -2,9 +2,10 @@
 #define FILESYSTEM_H
 
 #include "include/stb_image.h"
+#include "include/Log.hpp"
 #include <string>
 #include <filesystem>
-#include <iostream>
+#include <vector>
 
 class Loader
 {
@@ -18,7 +19,7 @@ public:
     {
         stbi_set_flip_vertically_on_load(true);
         std::string full_path = Loader::getPath(path);
-        std::cout << full_path << std::endl;
+        LOG_DEBUG("loading texture " << full_path);
         unsigned int textureID;
         glGenTextures(1, &textureID);
 
@@ -49,7 +50,7 @@ public:
         }
         else
         {
-            std::cout << "Texture failed to load at path: " << path << std::endl;
+            LOG_ERROR("Texture failed to load at path: " << path);
             stbi_image_free(data);
         }
 
@@ -73,7 +74,7 @@ public:
             }
             else
             {
-                std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+                LOG_ERROR("Cubemap texture failed to load at path: " << faces[i]);
                 stbi_image_free(data);
             }
         }
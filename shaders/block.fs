@@ -1,11 +1,19 @@
 #version 330 core
 
 in vec2 TexCoord;               
+in vec2 Light;
+in float Occlusion;
 out vec4 FragColor;
 
 uniform sampler2D atlasTex;      
 
 void main()
 {
-    FragColor = texture(atlasTex, TexCoord);
+    // each light level is 80% of the one above it, with a little left over so caves aren't black
+    float level = max(Light.x, Light.y) * 15.0;
+    float brightness = mix(0.04, 1.0, pow(0.8, 15.0 - level));
+    // a corner tucked in under three blocks ends up at half brightness
+    brightness *= mix(0.5, 1.0, Occlusion);
+    vec4 color = texture(atlasTex, TexCoord);
+    FragColor = vec4(color.rgb * brightness, color.a);
 }
@@ -1,8 +1,12 @@
 #version 330 core
 layout (location = 0) in vec3 aPos; // target for the position
 layout (location = 2) in vec2 aTexCoord; // target for the texture
+layout (location = 3) in vec2 aLight; // sky and block light, 0..1
+layout (location = 4) in float aOcclusion; // corner ambient occlusion, 0..1
 
 out vec2 TexCoord;
+out vec2 Light;
+out float Occlusion;
 
 uniform mat4 model;
 uniform mat4 view;
@@ -12,4 +16,6 @@ void main()
 {
     gl_Position = projection * view * model * vec4(aPos, 1.0f);
     TexCoord = aTexCoord;
+    Light = aLight;
+    Occlusion = aOcclusion;
 }
@@ -0,0 +1,14 @@
+#version 330 core
+layout (location = 0) in vec2 aPos; // pixels from the top left
+layout (location = 1) in vec4 aColour;
+
+out vec4 Colour;
+
+uniform vec2 screen; // framebuffer size in pixels
+
+void main()
+{
+    Colour = aColour;
+    vec2 ndc = aPos / screen * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+}
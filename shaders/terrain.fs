@@ -0,0 +1,25 @@
+#version 330 core
+
+in vec3 WorldPos;
+in vec3 Normal;
+out vec4 FragColor;
+
+uniform vec3 cameraPos;
+uniform float fogEnd;
+
+const vec3 grass = vec3(0.33, 0.55, 0.25);
+const vec3 rock = vec3(0.45, 0.45, 0.47);
+const vec3 sky = vec3(0.47, 0.75, 0.88); // keep in step with the clear colour
+const vec3 sunDir = normalize(vec3(0.4, 1.0, 0.3));
+
+void main()
+{
+    vec3 n = normalize(Normal);
+    // steep slopes read as bare rock
+    vec3 albedo = mix(rock, grass, smoothstep(0.6, 0.8, n.y));
+    vec3 colour = albedo * (0.45 + 0.55 * max(dot(n, sunDir), 0.0));
+
+    // fade into the sky towards the edge of the outer level
+    float fog = smoothstep(fogEnd * 0.3, fogEnd, length(WorldPos.xz - cameraPos.xz));
+    FragColor = vec4(mix(colour, sky, fog), 1.0);
+}
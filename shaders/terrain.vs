@@ -0,0 +1,37 @@
+#version 330 core
+layout (location = 0) in vec2 aGrid; // vertex (i, j) of a clipmap level
+
+out vec3 WorldPos;
+out vec3 Normal;
+
+uniform mat4 viewProjection;
+uniform sampler2D heights; // ring buffer, texel = world cell & texelMask
+uniform ivec2 origin;      // world cell of vertex (0, 0)
+uniform float spacing;     // blocks between vertices
+uniform int gridCells;
+uniform int texelMask;
+
+float heightAt(ivec2 v)
+{
+    v = clamp(v, ivec2(0), ivec2(gridCells));
+    return texelFetch(heights, (origin + v) & ivec2(texelMask), 0).r;
+}
+
+void main()
+{
+    ivec2 v = ivec2(aGrid);
+    float h = heightAt(v);
+    // odd vertices on the outer edge sit halfway along an edge of the next level out,
+    // so they take the average of their neighbours to close the crack
+    if ((v.x == 0 || v.x == gridCells) && (v.y & 1) == 1)
+        h = 0.5 * (heightAt(v - ivec2(0, 1)) + heightAt(v + ivec2(0, 1)));
+    if ((v.y == 0 || v.y == gridCells) && (v.x & 1) == 1)
+        h = 0.5 * (heightAt(v - ivec2(1, 0)) + heightAt(v + ivec2(1, 0)));
+
+    float dx = heightAt(v + ivec2(1, 0)) - heightAt(v - ivec2(1, 0));
+    float dz = heightAt(v + ivec2(0, 1)) - heightAt(v - ivec2(0, 1));
+    Normal = normalize(vec3(-dx, 2.0 * spacing, -dz));
+
+    WorldPos = vec3(vec2(origin + v) * spacing, h).xzy;
+    gl_Position = viewProjection * vec4(WorldPos, 1.0);
+}
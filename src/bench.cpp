@@ -0,0 +1,564 @@
+// world benchmarks, build it the same way as main.cpp (open this file and run the build task)
+// and run it from the repo root so the shaders and textures are found
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "include/shader_m.h"
+#include "include/World.hpp"
+#include "include/Collision.hpp"
+#include "include/WorldAccessor.hpp"
+#include "include/LightPropagator.hpp"
+#include "include/StagingRing.hpp"
+#include <scripts/Loader.h>
+
+#include "libs/glad/glad.h"
+#include "libs/glfw/glfw3.h"
+#include <libs/glm/glm.hpp>
+#include <libs/glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double msSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // the checks between the timings bump this, main exits with 1 if any of them failed
+    int failures = 0;
+
+    void check(const char *name, bool ok)
+    {
+        std::cout << (ok ? "  ok      " : "  FAILED  ") << name << std::endl;
+        failures += ok ? 0 : 1;
+    }
+
+    // the same camera every run, looking out over the loaded square from above
+    struct BenchCamera
+    {
+        glm::vec3 position{0.0f, 120.0f, 0.0f};
+        glm::mat4 viewProjection;
+        std::vector<glm::vec4> frustumPlanes;
+
+        BenchCamera()
+        {
+            glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WorldSettings::SCR_WIDTH / (float)WorldSettings::SCR_HEIGHT, 0.1f, 300.0f);
+            glm::mat4 view = glm::lookAt(position, position + glm::vec3(1.0f, -0.5f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            viewProjection = projection * view;
+            glm::mat4 t = glm::transpose(viewProjection);
+            frustumPlanes = {t[3] + t[0], t[3] - t[0], t[3] + t[1], t[3] - t[1], t[3] + t[2], t[3] - t[2]};
+        }
+    };
+
+    // runs frames until every loaded chunk has been generated, meshed and uploaded
+    double pumpUntilIdle(World &world, Shader &shader, const BenchCamera &camera)
+    {
+        auto start = Clock::now();
+        do
+        {
+            world.manageChunks(camera.position, shader, camera.frustumPlanes, camera.viewProjection);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        } while (world.pendingChunks() > 0);
+        return msSince(start);
+    }
+
+    void runEditBenchmark(const char *name, Shader &shader, const std::function<int(World &)> &edit)
+    {
+        BenchCamera camera;
+        World world;
+        double loadMs = pumpUntilIdle(world, shader, camera);
+        world.resetStats();
+
+        auto start = Clock::now();
+        int changed = edit(world);
+        double writeMs = msSince(start);
+        double remeshMs = pumpUntilIdle(world, shader, camera);
+
+        const WorldStats &stats = world.getStats();
+        std::cout << name << ": " << changed << " blocks changed, " << writeMs << "ms to write, "
+                  << remeshMs << "ms until every remesh was uploaded, " << stats.editRemeshes << " chunk uploads, "
+                  << (stats.editRemeshes ? stats.editLatencyMs / stats.editRemeshes : 0.0) << "ms avg / "
+                  << stats.maxEditLatencyMs << "ms max edit-to-visible (world loaded in " << loadMs << "ms)" << std::endl;
+    }
+
+    // the same reads through a fresh lookup per block and through one accessor that keeps its columns
+    void runBlockReadBenchmark(Shader &shader, const glm::ivec3 &min, const glm::ivec3 &max)
+    {
+        BenchCamera camera;
+        World world;
+        pumpUntilIdle(world, shader, camera);
+
+        auto start = Clock::now();
+        size_t solid = 0;
+        for (int y = min.y; y < max.y; y++)
+            for (int z = min.z; z < max.z; z++)
+                for (int x = min.x; x < max.x; x++)
+                    solid += world.getBlock(x, y, z) != BlockType::Air;
+        double worldMs = msSince(start);
+
+        start = Clock::now();
+        size_t accessorSolid = 0;
+        {
+            WorldAccessor access(world);
+            for (int y = min.y; y < max.y; y++)
+                for (int z = min.z; z < max.z; z++)
+                    for (int x = min.x; x < max.x; x++)
+                        accessorSolid += access.getBlock(x, y, z) != BlockType::Air;
+        }
+        double accessorMs = msSince(start);
+
+        const double reads = double(max.x - min.x) * (max.y - min.y) * (max.z - min.z);
+        std::cout << "block reads: " << size_t(reads) << " reads, " << worldMs << "ms through World::getBlock, "
+                  << accessorMs << "ms through a WorldAccessor (" << reads / (accessorMs / 1000.0) / 1e6 << "M reads/s), "
+                  << (solid == accessorSolid ? "same answers" : "ANSWERS DIFFER") << std::endl;
+        failures += solid == accessorSolid ? 0 : 1;
+    }
+
+    // relighting whole chunks from scratch, then single edits that only relight around themselves
+    void runLightBenchmark(Shader &shader)
+    {
+        BenchCamera camera;
+        World world;
+        pumpUntilIdle(world, shader, camera);
+
+        // the 9x9 chunks under the camera: each one's own fill as a worker does it, then the borders
+        WorldAccessor access(world);
+        std::vector<Chunk *> chunks;
+        for (int cz = -4; cz <= 4; cz++)
+            for (int cx = -4; cx <= 4; cx++)
+                chunks.push_back(access.chunkAt(cx, cz));
+
+        auto start = Clock::now();
+        for (Chunk *chunk : chunks)
+        {
+            LightPropagator::lightChunk(*chunk);
+        }
+        double fillMs = msSince(start);
+        start = Clock::now();
+        for (Chunk *chunk : chunks)
+        {
+            LightPropagator light(world, chunk->chunkX, chunk->chunkZ);
+            light.stitchCentre();
+            light.run();
+        }
+        double stitchMs = msSince(start);
+
+        // a light source dropped onto the surface and taken away again, then a hole dug next to it
+        std::mt19937 rng(WorldSettings::seed);
+        std::uniform_int_distribution<int> across(-100, 100);
+        world.resetStats();
+        start = Clock::now();
+        int edits = 0;
+        for (int i = 0; i < 1000; i++)
+        {
+            const int x = across(rng), z = across(rng);
+            RayHit ground = world.raycast(glm::vec3(x + 0.5f, 250.0f, z + 0.5f), glm::vec3(0.0f, -1.0f, 0.0f), 250.0f);
+            if (!ground.hit)
+                continue;
+            const glm::ivec3 top = ground.block + glm::ivec3(0, 1, 0);
+            world.setBlock(top.x, top.y, top.z, BlockType::Glowstone);
+            world.setBlock(top.x, top.y, top.z, BlockType::Air);
+            world.setBlock(ground.block.x, ground.block.y, ground.block.z, BlockType::Air);
+            edits += 3;
+        }
+        double editMs = msSince(start);
+        const WorldStats &stats = world.getStats();
+
+        std::cout << "light: " << fillMs / chunks.size() << "ms/chunk own fill, " << stitchMs / chunks.size()
+                  << "ms/chunk border stitch, " << edits << " single edits at " << (stats.relights ? stats.relightMs / stats.relights : 0.0)
+                  << "ms avg relight (" << editMs / std::max(edits, 1) << "ms per setBlock overall)" << std::endl;
+    }
+
+    // full resolution remeshes of the chunks under the camera, corner shading off and then on
+    void runMeshBenchmark(Shader &shader)
+    {
+        BenchCamera camera;
+        World world;
+        pumpUntilIdle(world, shader, camera);
+
+        std::vector<Chunk *> chunks;
+        {
+            WorldAccessor access(world);
+            for (int cz = -4; cz <= 4; cz++)
+                for (int cx = -4; cx <= 4; cx++)
+                    if (Chunk *chunk = access.chunkAt(cx, cz); chunk != nullptr && chunk->lod.load() == 0)
+                        chunks.push_back(chunk);
+        }
+
+        constexpr int rounds = 10;
+        double ms[2];
+        for (int occlusion = 0; occlusion < 2; occlusion++)
+        {
+            // the toggle remeshes everything, let that finish so no worker is on these chunks
+            world.setAmbientOcclusion(occlusion == 1);
+            pumpUntilIdle(world, shader, camera);
+            auto start = Clock::now();
+            for (int round = 0; round < rounds; round++)
+            {
+                for (Chunk *chunk : chunks)
+                {
+                    chunk->dirtySections = uint16_t((1u << WorldSettings::SECTION_COUNT) - 1);
+                    chunk->buildMesh();
+                }
+            }
+            ms[occlusion] = msSince(start) / (rounds * chunks.size());
+        }
+
+        std::cout << "meshing: " << chunks.size() << " chunks x " << rounds << ", " << ms[0] << "ms/chunk flat, "
+                  << ms[1] << "ms/chunk with ambient occlusion (" << 100.0 * (ms[1] / ms[0] - 1.0) << "% slower)" << std::endl;
+    }
+
+    // the plain walk World::raycast started out as: every voxel asked for through getBlock, no
+    // skipping over empty sections or unloaded columns. slow, but obviously right
+    RayHit referenceRaycast(World &world, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance)
+    {
+        RayHit hit;
+        const glm::vec3 dir = glm::normalize(direction);
+        glm::ivec3 voxel = glm::ivec3(glm::floor(origin));
+        glm::ivec3 step(0);
+        glm::vec3 tDelta(1e30f), tMax(1e30f);
+        for (int i = 0; i < 3; ++i)
+        {
+            if (dir[i] == 0.0f)
+                continue;
+            step[i] = dir[i] > 0.0f ? 1 : -1;
+            tDelta[i] = std::abs(1.0f / dir[i]);
+            tMax[i] = (float(step[i] > 0 ? voxel[i] + 1 : voxel[i]) - origin[i]) / dir[i];
+        }
+
+        float t = 0.0f;
+        while (t <= maxDistance)
+        {
+            BlockType type = world.getBlock(voxel.x, voxel.y, voxel.z);
+            if (type != BlockType::Air && type != BlockType::NoBlock)
+            {
+                hit.hit = true;
+                hit.block = voxel;
+                hit.distance = t;
+                hit.type = type;
+                return hit;
+            }
+            const int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+            t = tMax[axis];
+            voxel[axis] += step[axis];
+            tMax[axis] += tDelta[axis];
+        }
+        return hit;
+    }
+
+    bool sameHit(const RayHit &a, const RayHit &b)
+    {
+        return a.hit == b.hit && (!a.hit || (a.block == b.block && a.type == b.type));
+    }
+
+    // random rays from above the terrain in every direction, both one at a time and batched
+    void runRaycastBenchmark(Shader &shader)
+    {
+        BenchCamera camera;
+        World world;
+        pumpUntilIdle(world, shader, camera);
+
+        std::mt19937 rng(WorldSettings::seed);
+        std::uniform_real_distribution<float> across(-150.0f, 150.0f), height(60.0f, 180.0f), unit(-1.0f, 1.0f);
+        std::vector<Ray> rays(1 << 20);
+        for (Ray &ray : rays)
+        {
+            ray.origin = glm::vec3(across(rng), height(rng), across(rng));
+            ray.direction = glm::vec3(unit(rng), unit(rng), unit(rng));
+            ray.maxDistance = 128.0f;
+        }
+
+        auto start = Clock::now();
+        size_t hits = 0;
+        for (const Ray &ray : rays)
+        {
+            hits += world.raycast(ray.origin, ray.direction, ray.maxDistance).hit ? 1 : 0;
+        }
+        double singleMs = msSince(start);
+
+        std::vector<RayHit> results;
+        start = Clock::now();
+        world.raycast(rays, results);
+        double batchMs = msSince(start);
+
+        // the section and column skipping has to stop on the same first block as the plain walk,
+        // and the batch has to agree with the single rays
+        constexpr size_t checked = 20000;
+        size_t differ = 0;
+        for (size_t i = 0; i < checked; i++)
+        {
+            const RayHit expected = referenceRaycast(world, rays[i].origin, rays[i].direction, rays[i].maxDistance);
+            const RayHit got = world.raycast(rays[i].origin, rays[i].direction, rays[i].maxDistance);
+            differ += sameHit(got, expected) && sameHit(results[i], expected) ? 0 : 1;
+        }
+        failures += differ ? 1 : 0;
+
+        std::cout << "raycast: " << rays.size() << " rays, " << 100.0 * hits / rays.size() << "% hit, "
+                  << rays.size() / (singleMs / 1000.0) / 1e6 << "M rays/s one at a time, "
+                  << rays.size() / (batchMs / 1000.0) / 1e6 << "M rays/s batched, "
+                  << (differ ? "FIRST HITS DIFFER on " + std::to_string(differ) + " of " : std::string("same first hits as a per-voxel walk on "))
+                  << checked << " rays" << std::endl;
+    }
+
+    // 10k boxes dropped over the terrain with random horizontal speeds, stepped at 60Hz
+    void runCollisionBenchmark(Shader &shader)
+    {
+        BenchCamera camera;
+        World world;
+        pumpUntilIdle(world, shader, camera);
+
+        std::mt19937 rng(WorldSettings::seed);
+        std::uniform_real_distribution<float> across(-150.0f, 150.0f), height(60.0f, 200.0f), speed(-6.0f, 6.0f);
+        std::vector<Body> bodies(10000);
+        for (Body &body : bodies)
+        {
+            body.position = glm::vec3(across(rng), height(rng), across(rng));
+            body.velocity = glm::vec3(speed(rng), 0.0f, speed(rng));
+        }
+        std::vector<Body> batched = bodies;
+
+        constexpr int ticks = 300;
+        constexpr float dt = 1.0f / 60.0f;
+        auto start = Clock::now();
+        for (int tick = 0; tick < ticks; ++tick)
+        {
+            VoxelCollider collider(world);
+            for (Body &body : bodies)
+            {
+                collider.step(body, dt);
+            }
+        }
+        double singleMs = msSince(start);
+
+        start = Clock::now();
+        for (int tick = 0; tick < ticks; ++tick)
+        {
+            VoxelCollider::stepAll(world, batched, dt);
+        }
+        double batchMs = msSince(start);
+
+        size_t grounded = 0;
+        for (const Body &body : batched)
+        {
+            grounded += body.onGround ? 1 : 0;
+        }
+        std::cout << "collision: " << bodies.size() << " bodies, " << singleMs / ticks << "ms/tick one collider, "
+                  << batchMs / ticks << "ms/tick batched, " << grounded << " on the ground after " << ticks << " ticks" << std::endl;
+    }
+    // the staging ring the way the world uses it: workers allocating and writing while this thread
+    // copies out, releases and submits. a small ring so it keeps wrapping and running full, and every
+    // copy read back to see nothing was overwritten before the GPU had it
+    void checkStagingRing()
+    {
+        std::cout << "staging ring:" << std::endl;
+        StagingRing ring;
+        if (!ring.create(size_t(1) << 20))
+        {
+            std::cout << "  skipped, no GL 4.4 buffer storage here" << std::endl;
+            return;
+        }
+        // errors the benchmarks before left behind aren't this check's
+        while (glGetError() != GL_NO_ERROR)
+        {
+        }
+
+        // full: allocations without releases run out before the capacity does, and nothing that big fits
+        std::vector<StagingRing::Allocation> held;
+        StagingRing::Allocation a;
+        while (held.size() < 1024 && ring.allocate(4096, a))
+            held.push_back(a);
+        check("a full ring says no instead of handing out used space", held.size() < 1024 && ring.bytesInUse() <= ring.capacity());
+        check("an allocation as big as the ring is refused", !ring.allocate(ring.capacity(), a));
+        for (const StagingRing::Allocation &allocation : held)
+            ring.release(allocation);
+        for (int i = 0; i < 100 && ring.bytesInUse() > 0; i++)
+        {
+            glFinish();
+            ring.submit();
+        }
+        check("released space comes back once the GPU is done", ring.bytesInUse() == 0 && ring.allocate(4096, a));
+        ring.release(a);
+        ring.submit();
+
+        // each allocation filled with a pattern from its index, copied into one big buffer and checked there
+        constexpr int allocations = 5000;
+        constexpr size_t copyBytes = size_t(16) << 20;
+        auto word = [](uint32_t index, size_t k)
+        { return uint32_t(index * 2654435761u + k); };
+
+        GLuint copies;
+        glGenBuffers(1, &copies);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, copies);
+        glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(copyBytes), nullptr, GL_STATIC_DRAW);
+
+        std::mutex queueMutex;
+        std::deque<std::pair<StagingRing::Allocation, uint32_t>> queue;
+        std::atomic<int> next{0}, fullRetries{0};
+        std::vector<std::thread> workers;
+        for (int t = 0; t < 4; t++)
+        {
+            workers.emplace_back([&, t]
+                                 {
+                std::mt19937 rng(t);
+                std::uniform_int_distribution<size_t> words(1, 16384);
+                for (int i = next++; i < allocations; i = next++)
+                {
+                    const size_t bytes = 4 * words(rng);
+                    StagingRing::Allocation allocation;
+                    while (!ring.allocate(bytes, allocation))
+                    {
+                        fullRetries++;
+                        std::this_thread::yield();
+                    }
+                    uint32_t *data = reinterpret_cast<uint32_t *>(allocation.data);
+                    for (size_t k = 0; k < bytes / 4; k++)
+                        data[k] = word(uint32_t(i), k);
+                    std::lock_guard<std::mutex> lock(queueMutex);
+                    queue.push_back({allocation, uint32_t(i)});
+                } });
+        }
+
+        struct Copied
+        {
+            size_t offset, bytes;
+            uint32_t index;
+        };
+        std::vector<Copied> copied;
+        size_t copyOffset = 0, lastOffset = 0, wraps = 0, bad = 0;
+        auto readBack = [&]
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, copies);
+            std::vector<uint32_t> words;
+            for (const Copied &c : copied)
+            {
+                words.resize(c.bytes / 4);
+                glGetBufferSubData(GL_COPY_WRITE_BUFFER, GLintptr(c.offset), GLsizeiptr(c.bytes), words.data());
+                for (size_t k = 0; k < words.size(); k++)
+                {
+                    if (words[k] != word(c.index, k))
+                    {
+                        bad++;
+                        break;
+                    }
+                }
+            }
+            copied.clear();
+            copyOffset = 0;
+        };
+
+        // a few allocations are kept waiting before their copy like the world's budgeted uploads, so
+        // space handed out twice would be written over before it is read
+        std::deque<std::pair<StagingRing::Allocation, uint32_t>> waiting;
+        for (int done = 0; done < allocations;)
+        {
+            bool none = false;
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                none = queue.empty();
+                waiting.insert(waiting.end(), queue.begin(), queue.end());
+                queue.clear();
+            }
+            // nothing new means the workers are waiting on the ring, so everything goes
+            while (waiting.size() > (none ? 0 : 8))
+            {
+                const auto [allocation, index] = waiting.front();
+                waiting.pop_front();
+                if (copyOffset + allocation.bytes > copyBytes)
+                    readBack();
+                wraps += allocation.offset < lastOffset ? 1 : 0;
+                lastOffset = allocation.offset;
+                glBindBuffer(GL_COPY_READ_BUFFER, ring.buffer());
+                glBindBuffer(GL_COPY_WRITE_BUFFER, copies);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GLintptr(allocation.offset), GLintptr(copyOffset), GLsizeiptr(allocation.bytes));
+                copied.push_back(Copied{copyOffset, allocation.bytes, index});
+                copyOffset += allocation.bytes;
+                ring.release(allocation);
+                done++;
+            }
+            ring.submit();
+            if (none)
+                std::this_thread::yield();
+        }
+        for (std::thread &worker : workers)
+            worker.join();
+        readBack();
+        for (int i = 0; i < 100 && ring.bytesInUse() > 0; i++)
+        {
+            glFinish();
+            ring.submit();
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &copies);
+
+        std::cout << "  " << allocations << " allocations from 4 workers into " << (ring.capacity() >> 10) << "KiB, "
+                  << wraps << " wraps, " << fullRetries.load() << " retries on a full ring" << std::endl;
+        check("the ring wrapped around", wraps > 0);
+        check("every copy read back what its worker wrote", bad == 0);
+        check("everything is given back at the end", ring.bytesInUse() == 0 && glGetError() == GL_NO_ERROR);
+    }
+}
+
+int main()
+{
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    // the world still uploads meshes, so it needs a context even though nothing is shown
+    GLFWwindow *window = glfwCreateWindow(WorldSettings::SCR_WIDTH, WorldSettings::SCR_HEIGHT, "bench", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+    glEnable(GL_DEPTH_TEST);
+
+    Shader blockShader(Loader::getPath("shaders/block.vs"), Loader::getPath("shaders/block.fs"));
+
+    // clear a 256x64x256 region around the origin, once as a batch and once a voxel at a time
+    const glm::ivec3 clearMin(-128, 32, -128), clearMax(128, 96, 128);
+    runEditBenchmark("fillBox 256x64x256", blockShader, [&](World &world)
+                     { return world.fillBox(clearMin, clearMax, BlockType::Air); });
+    runEditBenchmark("setBlock 256x64x256", blockShader, [&](World &world)
+                     {
+        int changed = 0;
+        for (int y = clearMin.y; y < clearMax.y; y++)
+            for (int z = clearMin.z; z < clearMax.z; z++)
+                for (int x = clearMin.x; x < clearMax.x; x++)
+                    changed += world.getBlock(x, y, z) != BlockType::Air && world.setBlock(x, y, z, BlockType::Air);
+        return changed; });
+
+    runBlockReadBenchmark(blockShader, clearMin, clearMax);
+    runLightBenchmark(blockShader);
+    runMeshBenchmark(blockShader);
+    runRaycastBenchmark(blockShader);
+    runCollisionBenchmark(blockShader);
+    checkStagingRing();
+
+    glfwTerminate();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,426 @@
+// headless checks and timings for the CPU culling and draw ordering stages and the render distance
+// controller, no window and no GL context. build it the same way as main.cpp (open this file and run the build task)
+//
+//   cull_bench
+//
+// every check prints ok or FAILED against a scene small enough to know the answer for, the timings
+// run on bigger ones. exits with 1 if any check failed
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "include/CaveCuller.hpp"
+#include "include/Chunk.hpp"
+#include "include/DrawSorter.hpp"
+#include "include/LightPropagator.hpp"
+#include "include/OcclusionCuller.hpp"
+#include "include/RenderDistanceController.hpp"
+#include "include/SectionVisibility.hpp"
+#include "include/VoxelTypes.hpp"
+#include <scripts/Loader.h>
+
+#include <libs/glm/glm.hpp>
+#include <libs/glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double msSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    int failures = 0;
+
+    void check(const char *name, bool ok)
+    {
+        std::cout << (ok ? "  ok      " : "  FAILED  ") << name << std::endl;
+        failures += ok ? 0 : 1;
+    }
+
+    glm::mat4 lookFrom(const glm::vec3 &position, const glm::vec3 &direction, float aspect)
+    {
+        const glm::mat4 projection = glm::perspective(glm::radians(60.0f), aspect, 0.1f, 500.0f);
+        return projection * glm::lookAt(position, position + direction, glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    // one wall straight ahead of the camera, the answers are plain geometry
+    void checkOcclusion()
+    {
+        std::cout << "occlusion culling:" << std::endl;
+        OcclusionCuller culler(2);
+        const glm::vec3 eye(0.0f);
+        culler.beginFrame(lookFrom(eye, glm::vec3(1.0f, 0.0f, 0.0f), 2.0f), eye);
+        // covers everything within about 0.4 of the view axis, per unit of distance
+        culler.addOccluder(glm::vec3(10.0f, -4.0f, -4.0f), glm::vec3(12.0f, 4.0f, 4.0f));
+        culler.rasterize();
+
+        check("box right behind the wall is hidden", !culler.isVisible(AABB{glm::vec3(20.0f, -2.0f, -2.0f), glm::vec3(22.0f, 2.0f, 2.0f)}));
+        check("box beside the wall is visible", culler.isVisible(AABB{glm::vec3(20.0f, -2.0f, 12.0f), glm::vec3(22.0f, 2.0f, 16.0f)}));
+        check("box in front of the wall is visible", culler.isVisible(AABB{glm::vec3(5.0f, -1.0f, -1.0f), glm::vec3(6.0f, 1.0f, 1.0f)}));
+        check("box sticking out past the wall's edge is visible", culler.isVisible(AABB{glm::vec3(20.0f, -2.0f, 4.0f), glm::vec3(22.0f, 2.0f, 12.0f)}));
+    }
+
+    constexpr int W = WorldSettings::CHUNK_WIDTH;
+    constexpr int D = WorldSettings::CHUNK_DEPTH;
+    constexpr int H = WorldSettings::SECTION_HEIGHT;
+
+    void fill(Chunk &chunk, BlockType type)
+    {
+        for (int z = 0; z < D; z++)
+            for (int y = 0; y < WorldSettings::CHUNK_HEIGHT; y++)
+                for (int x = 0; x < W; x++)
+                    chunk.setBlock(x, y, z, type);
+    }
+
+    // meshes without neighbours and takes the section visibility the mesh came with, no GL needed
+    void mesh(Chunk &chunk)
+    {
+        chunk.buildMesh(std::array<const Chunk *, 9>{}, false);
+        chunk.takeMeshInfo();
+    }
+
+    // a straight one block tunnel along x through the chunk
+    void carveTunnel(Chunk &chunk, int y, int z)
+    {
+        for (int x = 0; x < W; x++)
+            chunk.setBlock(x, y, z, BlockType::Air);
+    }
+
+    void checkSectionVisibility(FastNoiseLite &noise)
+    {
+        std::cout << "section connectivity:" << std::endl;
+        constexpr int section = 6;
+        Chunk chunk(0, 0, noise);
+        fill(chunk, BlockType::Stone);
+        mesh(chunk);
+        check("a solid section connects no faces", chunk.getSectionVisibility()[section] == SectionVisibility::NONE_CONNECTED);
+
+        Chunk open(0, 0, noise);
+        mesh(open);
+        check("an open section connects every pair of faces", open.getSectionVisibility()[section] == SectionVisibility::ALL_CONNECTED);
+
+        Chunk tunnel(0, 0, noise);
+        fill(tunnel, BlockType::Stone);
+        carveTunnel(tunnel, section * H + H / 2, D / 2);
+        mesh(tunnel);
+        const uint16_t throughX = uint16_t(1u << SectionVisibility::pairBit(4, 5));
+        check("a tunnel along x connects +X to -X and nothing else", tunnel.getSectionVisibility()[section] == throughX);
+        check("the sections above and below the tunnel stay closed",
+              tunnel.getSectionVisibility()[section - 1] == SectionVisibility::NONE_CONNECTED &&
+                  tunnel.getSectionVisibility()[section + 1] == SectionVisibility::NONE_CONNECTED);
+    }
+
+    // three chunks in a row along x: open air around the camera, a wall of rock, and a chunk past it
+    // with a pocket of air in the middle. returns how many of them the search reached
+    int caveReaches(FastNoiseLite &noise, bool tunnel)
+    {
+        constexpr int y = 6 * H + H / 2;
+        std::vector<std::unique_ptr<Chunk>> row;
+        for (int cx = 0; cx < 3; cx++)
+            row.push_back(std::make_unique<Chunk>(cx, 0, noise));
+        fill(*row[1], BlockType::Stone);
+        fill(*row[2], BlockType::Stone);
+        for (int z = 4; z < 12; z++)
+            for (int x = 4; x < 12; x++)
+                row[2]->setBlock(x, y, z, BlockType::Air);
+        if (tunnel)
+            carveTunnel(*row[1], y, D / 2);
+        for (auto &chunk : row)
+            mesh(*chunk);
+
+        // planes every box is inside of, the frustum plays no part here
+        const std::vector<glm::vec4> everything(6, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        CaveCuller cave;
+        if (!cave.search(glm::vec3(W / 2, y, D / 2), everything, [&](int cx, int cz)
+                         { return cz == 0 && cx >= 0 && cx < 3 ? row[cx].get() : nullptr; }))
+            return 0;
+        int reached = 0;
+        for (auto &chunk : row)
+            reached += cave.reached(*chunk) ? 1 : 0;
+        return reached;
+    }
+
+    void checkCaveCulling(FastNoiseLite &noise)
+    {
+        std::cout << "cave culling:" << std::endl;
+        // the wall itself is always reached, the search has to walk into it to find it closed
+        check("a chunk walled off by solid rock is dropped", caveReaches(noise, false) == 2);
+        check("the same chunk is kept once a tunnel leads to it", caveReaches(noise, true) == 3);
+    }
+
+    /*
+        Counts the fragments a depth-tested draw of the meshes would shade, with
+        early-Z, on a small CPU framebuffer. Shaded fragments over covered pixels
+        is the overdraw.
+        Triangles that reach behind the near plane are dropped rather than clipped,
+        with the camera up in the air there are next to none.
+    */
+    class OverdrawCounter
+    {
+        public:
+        static constexpr int WIDTH = 320, HEIGHT = 200;
+
+        OverdrawCounter() : depth(size_t(WIDTH) * HEIGHT, std::numeric_limits<float>::max()) {}
+
+        void draw(const Chunk &chunk, const glm::mat4 &viewProjection)
+        {
+            const glm::vec3 offset(chunk.chunkX * WorldSettings::CHUNK_WIDTH, 0.0f, chunk.chunkZ * WorldSettings::CHUNK_DEPTH);
+            const std::vector<Vertex> &verts = chunk.meshVertices();
+            const std::vector<uint32_t> &idx = chunk.meshIndices();
+            screen.resize(verts.size());
+            for (size_t i = 0; i < verts.size(); i++)
+            {
+                glm::vec4 clip = viewProjection * glm::vec4(verts[i].Position + offset, 1.0f);
+                screen[i] = clip.w < 0.1f ? glm::vec3(std::numeric_limits<float>::quiet_NaN())
+                                          : glm::vec3((clip.x / clip.w * 0.5f + 0.5f) * WIDTH, (clip.y / clip.w * 0.5f + 0.5f) * HEIGHT, clip.z / clip.w);
+            }
+            for (size_t i = 0; i + 2 < idx.size(); i += 3)
+            {
+                triangle(screen[idx[i]], screen[idx[i + 1]], screen[idx[i + 2]]);
+            }
+        }
+
+        size_t shadedFragments() const { return shaded; }
+        size_t coveredPixels() const
+        {
+            return size_t(std::count_if(depth.begin(), depth.end(), [](float d)
+                                        { return d != std::numeric_limits<float>::max(); }));
+        }
+
+        private:
+        void triangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+        {
+            if (std::isnan(a.x) || std::isnan(b.x) || std::isnan(c.x))
+                return;
+            // counter-clockwise faces the camera, the rest is back-face culled like on the GPU
+            const float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            if (area <= 0.0f)
+                return;
+            const int x0 = std::max(0, int(std::floor(std::min({a.x, b.x, c.x}))));
+            const int x1 = std::min(WIDTH - 1, int(std::ceil(std::max({a.x, b.x, c.x}))));
+            const int y0 = std::max(0, int(std::floor(std::min({a.y, b.y, c.y}))));
+            const int y1 = std::min(HEIGHT - 1, int(std::ceil(std::max({a.y, b.y, c.y}))));
+            for (int y = y0; y <= y1; y++)
+            {
+                for (int x = x0; x <= x1; x++)
+                {
+                    const glm::vec2 p(x + 0.5f, y + 0.5f);
+                    const float wa = (c.x - b.x) * (p.y - b.y) - (c.y - b.y) * (p.x - b.x);
+                    const float wb = (a.x - c.x) * (p.y - c.y) - (a.y - c.y) * (p.x - c.x);
+                    const float wc = area - wa - wb;
+                    if (wa < 0.0f || wb < 0.0f || wc < 0.0f)
+                        continue;
+                    const float z = (wa * a.z + wb * b.z + wc * c.z) / area;
+                    float &stored = depth[size_t(y) * WIDTH + x];
+                    if (z < stored)
+                    {
+                        stored = z;
+                        shaded++;
+                    }
+                }
+            }
+        }
+
+        std::vector<float> depth;
+        std::vector<glm::vec3> screen;
+        size_t shaded = 0;
+    };
+
+    // what DrawSorter orders by, distance to the nearest point of the chunk's box
+    float sortDistance(const Chunk &chunk, const glm::vec3 &cameraPos)
+    {
+        const AABB &box = chunk.getBox();
+        return glm::length(glm::clamp(cameraPos, box.vmin, box.vmax) - cameraPos);
+    }
+
+    // a square of real terrain drawn in a random order (what the world's hash map gave us before draws
+    // were sorted) and in DrawSorter's front to back order. the same pixels end up covered either way,
+    // sorted should shade fewer fragments to get there
+    void checkDrawOrder(FastNoiseLite &noise)
+    {
+        std::cout << "draw order:" << std::endl;
+        constexpr int radius = 3, side = 2 * radius + 1;
+        std::vector<std::unique_ptr<Chunk>> chunks;
+        for (int z = 0; z < side; z++)
+            for (int x = 0; x < side; x++)
+            {
+                chunks.push_back(std::make_unique<Chunk>(x - radius, z - radius, noise));
+                chunks.back()->generate();
+                LightPropagator::lightChunk(*chunks.back());
+                chunks.back()->generated = true;
+            }
+        for (int z = 0; z < side; z++)
+            for (int x = 0; x < side; x++)
+            {
+                std::array<const Chunk *, 9> around{};
+                for (int dz = -1; dz <= 1; dz++)
+                    for (int dx = -1; dx <= 1; dx++)
+                        if (x + dx >= 0 && x + dx < side && z + dz >= 0 && z + dz < side)
+                            around[(dx + 1) + 3 * (dz + 1)] = chunks[size_t(x + dx + side * (z + dz))].get();
+                chunks[size_t(x + side * z)]->buildMesh(around, true);
+            }
+
+        // standing over the middle of the square, looking out across it and a little down
+        const glm::vec3 position(8.0f, float(Chunk::surfaceHeight(noise, 8, 8) + 20), 8.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), float(OverdrawCounter::WIDTH) / OverdrawCounter::HEIGHT, 0.1f, 300.0f);
+        glm::mat4 view = glm::lookAt(position, position + glm::vec3(1.0f, -0.3f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 viewProjection = projection * view;
+
+        std::vector<Chunk *> order;
+        for (const auto &chunk : chunks)
+            order.push_back(chunk.get());
+        std::mt19937 rng(1337);
+        std::shuffle(order.begin(), order.end(), rng);
+
+        OverdrawCounter unsorted;
+        for (Chunk *chunk : order)
+            unsorted.draw(*chunk, viewProjection);
+
+        DrawSorter sorter;
+        sorter.sort(order, position);
+        bool frontToBack = true;
+        for (size_t i = 1; i < order.size(); i++)
+            frontToBack = frontToBack && sortDistance(*order[i - 1], position) <= sortDistance(*order[i], position) + 0.1f;
+        OverdrawCounter sorted;
+        for (Chunk *chunk : order)
+            sorted.draw(*chunk, viewProjection);
+
+        check("the sorter puts nearer chunks first", frontToBack);
+        check("both orders cover the same pixels", sorted.coveredPixels() == unsorted.coveredPixels() && sorted.coveredPixels() > 0);
+        check("front to back shades fewer fragments than a random order", sorted.shadedFragments() < unsorted.shadedFragments());
+        const double covered = double(std::max<size_t>(1, sorted.coveredPixels()));
+        std::cout << "overdraw: " << sorted.coveredPixels() << " pixels covered at " << OverdrawCounter::WIDTH << "x"
+                  << OverdrawCounter::HEIGHT << ", " << unsorted.shadedFragments() / covered << "x shaded in random order, "
+                  << sorted.shadedFragments() / covered << "x front to back" << std::endl;
+    }
+
+    // a hilly field of columns around the camera like the world's occluders, and a box per chunk to test
+    void timeOcclusion()
+    {
+        constexpr int frames = 200;
+        constexpr int columns = 48;
+        constexpr float cell = 8.0f;
+        std::mt19937 rng(1337);
+        std::uniform_real_distribution<float> height(20.0f, 90.0f);
+        std::vector<float> heights(columns * columns);
+        for (float &h : heights)
+            h = height(rng);
+
+        std::vector<AABB> chunks;
+        for (int z = -10; z <= 10; z++)
+            for (int x = -10; x <= 10; x++)
+                chunks.push_back(AABB{glm::vec3(x * 16.0f, 0.0f, z * 16.0f), glm::vec3(x * 16.0f + 16.0f, 80.0f, z * 16.0f + 16.0f)});
+
+        OcclusionCuller culler(std::max(1u, std::thread::hardware_concurrency() / 2));
+        const glm::vec3 eye(0.0f, 60.0f, 0.0f);
+        double rasterMs = 0.0, testMs = 0.0;
+        size_t hidden = 0;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            const float angle = float(frame) * 0.03f;
+            const glm::vec3 direction(std::cos(angle), -0.2f, std::sin(angle));
+            auto start = Clock::now();
+            culler.beginFrame(lookFrom(eye, direction, 2.0f), eye);
+            for (int z = 0; z < columns; z++)
+                for (int x = 0; x < columns; x++)
+                {
+                    const glm::vec3 vmin((x - columns / 2) * cell, 0.0f, (z - columns / 2) * cell);
+                    culler.addOccluder(vmin, vmin + glm::vec3(cell, heights[z * columns + x], cell));
+                }
+            culler.rasterize();
+            rasterMs += msSince(start);
+
+            start = Clock::now();
+            for (const AABB &box : chunks)
+                hidden += culler.isVisible(box) ? 0 : 1;
+            testMs += msSince(start);
+        }
+        std::cout << "occlusion timing: " << columns * columns << " occluder boxes, " << culler.occluderTriangles()
+                  << " triangles, " << rasterMs / frames << "ms/frame to rasterize, " << 1000.0 * testMs / (frames * chunks.size())
+                  << "us per box tested, " << 100.0 * hidden / (frames * chunks.size()) << "% of " << chunks.size() << " boxes hidden" << std::endl;
+    }
+    // the render distance controller against a made up machine: a frame is a fixed part plus a cost per
+    // loaded chunk plus a bump while new chunks are loading, and under vsync never less than the refresh
+    // interval. every cost starts once close in and once far out, an interval is a second like in main
+    void checkRenderDistance()
+    {
+        std::cout << "render distance:" << std::endl;
+
+        constexpr int intervals = 600;
+        constexpr double baseMs = 2.0, loadingMs = 4.0, chunksPerSecond = 120.0;
+        const double budget = RenderDistanceController::Settings{}.frameBudgetMs;
+        auto workAt = [&](int radius, double msPerChunk)
+        { return baseMs + msPerChunk * double((2 * radius + 1) * (2 * radius + 1)); };
+
+        const std::pair<const char *, double> costs[] = {{"cheap", 0.005}, {"medium", 0.02}, {"expensive", 0.08}};
+        for (const auto &[name, msPerChunk] : costs)
+        {
+            for (int start : {6, 20})
+            {
+                RenderDistanceController controller(start);
+                int radius = start;
+                double pending = 0.0;
+                int reversals = 0, lastDirection = 0, lastChange = -1;
+                for (int i = 0; i < intervals; i++)
+                {
+                    RenderDistanceController::Load load;
+                    load.workP90Ms = workAt(radius, msPerChunk) + (pending > 0.0 ? loadingMs : 0.0);
+                    load.frameP90Ms = std::max(load.workP90Ms, budget);
+                    pending = std::max(0.0, pending - chunksPerSecond);
+                    load.pendingChunks = size_t(pending);
+                    load.chunksPerSecond = chunksPerSecond;
+
+                    const int next = controller.update(load, 1.0);
+                    if (next == radius)
+                        continue;
+                    // a grow has the new rings to load, a shrink just drops them
+                    pending = std::max(0.0, pending + double((2 * next + 1) * (2 * next + 1) - (2 * radius + 1) * (2 * radius + 1)));
+                    const int direction = next > radius ? 1 : -1;
+                    reversals += lastDirection != 0 && direction != lastDirection ? 1 : 0;
+                    lastDirection = direction;
+                    lastChange = i;
+                    radius = next;
+                }
+
+                // inside the shrink threshold, and not so far under it that it should have grown
+                const double work = workAt(radius, msPerChunk);
+                const bool fits = work <= budget * 1.1;
+                const bool noHeadroom = radius == WorldSettings::MAX_RENDER_DISTANCE || work >= budget * 0.75;
+                std::cout << "  " << name << " chunks (" << msPerChunk << "ms each), radius " << start << " -> " << radius << ", "
+                          << work << "ms of work in a " << budget << "ms budget, " << reversals << " reversals, last change after "
+                          << lastChange + 1 << "s" << std::endl;
+                check((std::string(name) + " from " + std::to_string(start) + " ends inside the budget with no headroom left").c_str(), fits && noHeadroom);
+                check((std::string(name) + " from " + std::to_string(start) + " settles without see-sawing").c_str(),
+                      reversals <= 1 && lastChange < intervals / 2);
+            }
+        }
+    }
+}
+
+int main()
+{
+    FastNoiseLite noise;
+    Chunk::setupNoise(noise, WorldSettings::seed);
+
+    checkOcclusion();
+    timeOcclusion();
+    checkSectionVisibility(noise);
+    checkCaveCulling(noise);
+    checkDrawOrder(noise);
+    checkRenderDistance();
+
+    std::cout << (failures ? std::to_string(failures) + " checks FAILED" : std::string("all checks passed")) << std::endl;
+    return failures ? 1 : 0;
+}
@@ -5,11 +5,20 @@
 #include <vector>
 #include <iostream>
 #include <random>
+#include <algorithm>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "include/shader_m.h"
 #include <include/camera.h>
 #include "include/World.hpp"
+#include "include/CameraPath.hpp"
+#include "include/Collision.hpp"
+#include "include/GpuProfiler.hpp"
+#include "include/Hud.hpp"
+#include "include/Log.hpp"
+#include "include/Metrics.hpp"
+#include "include/RenderDistanceController.hpp"
+#include "include/Trace.hpp"
 #include <scripts/Loader.h>
 
 #include "libs/glad/glad.h"
@@ -58,11 +67,16 @@ int main()
     GLFWwindow *window = glfwCreateWindow(WorldSettings::SCR_WIDTH, WorldSettings::SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
     if (window == NULL)
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
+        LOG_ERROR("Failed to create GLFW window");
         glfwTerminate();
         return -1;
     }
+    // hidden, shares buffers with the main window's context, for the world's upload thread (U)
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *uploadWindow = glfwCreateWindow(1, 1, "uploads", NULL, window);
     glfwMakeContextCurrent(window);
+    // vsync on, whatever the driver's default is. the adaptive render distance budgets for it
+    glfwSwapInterval(1);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); // callback function executes everytime the window is resized
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
@@ -74,7 +88,7 @@ int main()
     // ---------------------------------------
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
+        LOG_ERROR("Failed to initialize GLAD");
         return -1;
     }
 
@@ -87,35 +101,217 @@ int main()
                        Loader::getPath("shaders/block.fs"));
 
     World world;
-
-    GLuint query;
-    glGenQueries(1, &query);
+    Hud hud;
+    Metrics::Histogram &frameTime = Metrics::histogram("frame ms");
+    // the frame up to the swap, what it costs us rather than how long vsync made it
+    Metrics::Histogram &frameWorkTime = Metrics::histogram("frame work ms");
+    // H shows the metrics on screen, M writes them to metrics.csv and metrics.json every second
+    bool showHud = false, dumpMetrics = false;
+    // V switches between the adaptive render distance and the fixed RENDER_DISTANCE
+    RenderDistanceController::Settings distanceSettings;
+    distanceSettings.memoryBudgetMiB = 2048.0;
+    // a frame can't come round faster than the monitor refreshes
+    const GLFWvidmode *videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    if (videoMode != NULL && videoMode->refreshRate > 0)
+        distanceSettings.frameBudgetMs = 1000.0 / videoMode->refreshRate;
+    RenderDistanceController distance(world.renderDistance(), distanceSettings);
+    bool adaptiveDistance = true;
+    Metrics::Gauge &distanceGauge = Metrics::gauge("render distance");
+
+    // gpu time and primitives per pass, read back a few frames late so nothing waits on the gpu
+    GpuProfiler gpu;
 
     float lastTime = static_cast<float>(glfwGetTime());
     int nbFrames = 0;
     // render loop
     // -----------
+    Trace::setThreadName("render");
     while (!glfwWindowShouldClose(window))
     {
+        TRACE_ZONE("frame");
         // per-frame time logic
         // --------------------
-        float currentFrame = static_cast<float>(glfwGetTime());
+        const double frameStart = glfwGetTime();
+        float currentFrame = static_cast<float>(frameStart);
         deltaTime = currentFrame - lastFrame;
+        // the first frame has nothing before it to measure from
+        if (lastFrame > 0.0f)
+            frameTime.record(deltaTime * 1000.0);
         lastFrame = currentFrame;
 
         nbFrames++;
         if (currentFrame - lastTime >= 1.0)
         {
-            std::cout << 1000.0 / nbFrames << "ms/frame" << std::endl;
+            // the average hides the hitches, the tail is what you feel
+            const Metrics::Snapshot &snapshot = Metrics::sample();
+            const Metrics::Row *frames = Metrics::find(snapshot, "frame ms");
+            const Metrics::Row *gpuFrames = Metrics::find(snapshot, "gpu frame ms");
+            LOG_INFO(1000.0 / nbFrames << "ms/frame, p50 " << (frames ? frames->latency.p50 : 0.0) << "ms p99 "
+                     << (frames ? frames->latency.p99 : 0.0) << "ms max " << (frames ? frames->latency.max : 0.0) << "ms | gpu p50 "
+                     << (gpuFrames ? gpuFrames->latency.p50 : 0.0) << "ms p99 " << (gpuFrames ? gpuFrames->latency.p99 : 0.0) << "ms");
+            if (adaptiveDistance)
+            {
+                const Metrics::Row *generated = Metrics::find(snapshot, "chunks generated");
+                const Metrics::Row *work = Metrics::find(snapshot, "frame work ms");
+                // a GPU-bound frame spends its time waiting in the swap, so the GPU's time counts as work too
+                const double workP90 = std::max(work ? work->latency.p90 : 0.0, gpuFrames ? gpuFrames->latency.p90 : 0.0);
+                const RenderDistanceController::Load load{frames ? frames->latency.p90 : 0.0, workP90, world.pendingChunks(),
+                                                          generated ? generated->rate : 0.0, RenderDistanceController::residentMiB()};
+                const int radius = distance.update(load, snapshot.interval);
+                if (radius != world.renderDistance())
+                {
+                    LOG_INFO("render distance " << world.renderDistance() << " -> " << radius << " (" << distance.reason() << ")");
+                    world.setRenderDistance(radius);
+                }
+            }
+            distanceGauge.set(double(world.renderDistance()));
+            if (dumpMetrics && !(Metrics::appendCsv(snapshot, "metrics.csv") && Metrics::writeJson(snapshot, "metrics.json")))
+                LOG_WARN("couldn't write metrics.csv/metrics.json");
+
+            // streaming only pays on chunk crossings, culling pays every frame
+            const WorldStats &stats = world.getStats();
+            LOG_INFO("stream: " << stats.streamUpdates << " updates, " << stats.streamMs << "ms total (+"
+                      << stats.chunksLoaded << " -" << stats.chunksUnloaded << " chunks) | cull: "
+                      << (stats.cullFrames ? stats.cullMs / stats.cullFrames : 0.0) << "ms/frame, "
+                      << stats.visibleChunks << "/" << stats.culledChunks << " chunks visible, "
+                      << stats.visibleTriangles << " triangles, " << stats.caveCulledChunks << " cave culled, "
+                      << stats.occludedChunks << " occluded ("
+                      << (stats.cullFrames ? stats.occlusionMs / stats.cullFrames : 0.0) << "ms/frame), "
+                      << stats.incrementalSorts << "/" << stats.cullFrames << " incremental sorts | far: "
+                      << stats.farLevelUpdates << " levels resampled | edits: " << stats.blockEdits << " blocks, "
+                      << (stats.editRemeshes ? stats.editLatencyMs / stats.editRemeshes : 0.0) << "ms avg "
+                      << stats.maxEditLatencyMs << "ms max to visible | light: " << stats.lightStitches << " stitched in "
+                      << stats.lightStitchMs << "ms, " << stats.borderRemeshes << " border remeshes, " << (stats.relights ? stats.relightMs / stats.relights : 0.0)
+                      << "ms avg relight");
+            world.resetStats();
             nbFrames = 0;
             lastTime += 1.0;
         }
         // input
         // -----
+        glm::vec3 beforeInput = camera.Position;
         processInput(window);
+
+        // the camera is a player-sized box with the eye near the top, N toggles flying through terrain
+        static bool noclip = false, noclipWasDown = false;
+        bool noclipDown = glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS;
+        if (noclipDown && !noclipWasDown)
+            noclip = !noclip;
+        noclipWasDown = noclipDown;
+        // O switches corner shading off and on to compare
+        static bool occlusionWasDown = false;
+        bool occlusionDown = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+        if (occlusionDown && !occlusionWasDown)
+            world.setAmbientOcclusion(!world.ambientOcclusionEnabled());
+        occlusionWasDown = occlusionDown;
+        // T starts a trace, pressing it again writes trace.json (chrome://tracing or ui.perfetto.dev)
+        static bool traceWasDown = false;
+        bool traceDown = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+        if (traceDown && !traceWasDown)
+        {
+            Trace::setEnabled(!Trace::enabled());
+            if (!Trace::enabled())
+                LOG_INFO((Trace::writeChromeJson("trace.json") ? "wrote trace.json" : "couldn't write trace.json"));
+        }
+        traceWasDown = traceDown;
+        static bool hudWasDown = false, dumpWasDown = false;
+        bool hudDown = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+        if (hudDown && !hudWasDown)
+            showHud = !showHud;
+        hudWasDown = hudDown;
+        bool dumpDown = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+        if (dumpDown && !dumpWasDown)
+        {
+            dumpMetrics = !dumpMetrics;
+            LOG_INFO((dumpMetrics ? "writing metrics.csv and metrics.json every second" : "stopped writing metrics"));
+        }
+        dumpWasDown = dumpDown;
+        static bool distanceWasDown = false;
+        bool distanceDown = glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS;
+        if (distanceDown && !distanceWasDown)
+        {
+            adaptiveDistance = !adaptiveDistance;
+            if (!adaptiveDistance)
+                world.setRenderDistance(WorldSettings::RENDER_DISTANCE);
+            // picks up from wherever the distance is now
+            distance = RenderDistanceController(world.renderDistance(), distanceSettings);
+            LOG_INFO((adaptiveDistance ? "adaptive render distance" : "fixed render distance"));
+        }
+        distanceWasDown = distanceDown;
+        // P switches prefetching ahead of the camera off and on to compare
+        static bool prefetchWasDown = false;
+        bool prefetchDown = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+        if (prefetchDown && !prefetchWasDown)
+        {
+            world.setPrefetching(!world.prefetchingEnabled());
+            LOG_INFO((world.prefetchingEnabled() ? "prefetching on" : "prefetching off"));
+        }
+        prefetchWasDown = prefetchDown;
+        // U moves mesh uploads onto a thread with its own context and back, to compare frame times
+        static bool uploadWasDown = false;
+        bool uploadDown = glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS;
+        if (uploadDown && !uploadWasDown && uploadWindow != NULL)
+        {
+            if (world.uploadThreadRunning())
+                world.stopUploadThread();
+            else
+                world.startUploadThread([uploadWindow](bool bind) { glfwMakeContextCurrent(bind ? uploadWindow : NULL); });
+            LOG_INFO((world.uploadThreadRunning() ? "uploading on a thread of its own" : "uploading on the render thread"));
+        }
+        uploadWasDown = uploadDown;
+        // R records the flight to camera_path.txt for src/replay.cpp, pressing it again saves it
+        static bool recordWasDown = false, recording = false;
+        static CameraPath recordedPath;
+        static float recordStart = 0.0f;
+        bool recordDown = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+        if (recordDown && !recordWasDown)
+        {
+            recording = !recording;
+            if (recording)
+            {
+                recordedPath.clear();
+                recordStart = currentFrame;
+                LOG_INFO("recording camera path");
+            }
+            else
+                LOG_INFO((recordedPath.save("camera_path.txt") ? "wrote camera_path.txt" : "couldn't write camera_path.txt"));
+        }
+        recordWasDown = recordDown;
+        if (!noclip)
+        {
+            const glm::vec3 eyeOffset(0.0f, 0.72f, 0.0f);
+            Body player;
+            player.position = beforeInput - eyeOffset;
+            glm::bvec3 blocked;
+            VoxelCollider collider(world);
+            camera.Position = beforeInput + collider.move(player.box(), camera.Position - beforeInput, blocked);
+        }
+        if (recording)
+            recordedPath.add(CameraKey{double(currentFrame - recordStart), camera.Position, camera.Yaw, camera.Pitch});
+
+        // left click breaks the block under the crosshair, right click puts dirt against it
+        // and middle click a glowstone
+        static bool leftWasDown = false, rightWasDown = false, middleWasDown = false;
+        bool leftDown = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+        bool rightDown = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+        bool middleDown = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_MIDDLE) == GLFW_PRESS;
+        if ((leftDown && !leftWasDown) || (rightDown && !rightWasDown) || (middleDown && !middleWasDown))
+        {
+            RayHit hit = world.raycast(camera.Position, camera.Front, 8.0f);
+            if (hit.hit && leftDown && !leftWasDown)
+                world.setBlock(hit.block.x, hit.block.y, hit.block.z, BlockType::Air);
+            else if (hit.hit && hit.normal != glm::ivec3(0))
+            {
+                BlockType place = middleDown && !middleWasDown ? BlockType::Glowstone : BlockType::Dirt;
+                world.setBlock(hit.block.x + hit.normal.x, hit.block.y + hit.normal.y, hit.block.z + hit.normal.z, place);
+            }
+        }
+        leftWasDown = leftDown;
+        rightWasDown = rightDown;
+        middleWasDown = middleDown;
         // glDisable(GL_CULL_FACE);
 
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)WorldSettings::SCR_WIDTH / (float)WorldSettings::SCR_HEIGHT, 0.1f, 300.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)WorldSettings::SCR_WIDTH / (float)WorldSettings::SCR_HEIGHT, 0.1f, world.chunkViewDistance());
         glm::mat4 view = camera.GetViewMatrix();
 
         const glm::mat4 viewProjection = projection * view;
@@ -134,6 +330,8 @@ int main()
             (viewProjectionTransposed[3] - viewProjectionTransposed[2]),
         };
 
+        // the hud and the far terrain leave their own programs bound
+        blockShader.use();
         blockShader.setMat4("projection", projection);
         blockShader.setMat4("view", view);
         // render
@@ -141,32 +339,47 @@ int main()
         glClearColor(0.47f, 0.75f, 0.88f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        world.manageChunks(camera.Position, blockShader, frustumPlanes);
-        // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glEndQuery(GL_PRIMITIVES_GENERATED);
-
-        GLuint primitives;
-        glGetQueryObjectuiv(query, GL_QUERY_RESULT, &primitives);
-
-        // static size_t frameCounter=0, indexSum=0;
-        // frameCounter++;
-        // indexSum += primitives;
+        // the horizon gets its own near/far so the chunks keep their depth precision
+        gpu.beginFrame();
+        glm::mat4 farProjection = glm::perspective(glm::radians(camera.Zoom), (float)WorldSettings::SCR_WIDTH / (float)WorldSettings::SCR_HEIGHT, 8.0f, FarTerrain::VIEW_DISTANCE * 1.5f);
+        {
+            GpuProfiler::Pass pass(gpu, "far terrain");
+            world.drawFarTerrain(farProjection * view, camera.Position);
+            glClear(GL_DEPTH_BUFFER_BIT);
+        }
 
-        // if (frameCounter == 60) {
-        //   std::cout << "Avg indices/frame: " << (indexSum/60) << "\n";
-        //   frameCounter = indexSum = 0;
-        // }
+        // streaming, uploads and culling are CPU work, the pass only brackets the draws
+        world.updateChunks(camera.Position, frustumPlanes, viewProjection);
+        {
+            GpuProfiler::Pass pass(gpu, "chunks");
+            world.drawVisibleChunks(blockShader);
+        }
+        if (showHud)
+        {
+            GpuProfiler::Pass pass(gpu, "hud");
+            int fbWidth = 0, fbHeight = 0;
+            glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
+            hud.draw(Metrics::describe(Metrics::lastSnapshot()), fbWidth, fbHeight);
+        }
+        gpu.endFrame();
+        // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
+        frameWorkTime.record((glfwGetTime() - frameStart) * 1000.0);
+        {
+            TRACE_ZONE("swap");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
     }
 
+    // its context goes with glfwTerminate
+    world.stopUploadThread();
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
-    glDeleteQueries(1, &query);
     return 0;
 }
 
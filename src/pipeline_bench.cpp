@@ -0,0 +1,213 @@
+// headless chunk pipeline benchmark: generation, lighting and meshing on a thread pool, no window
+// and no GL context. build it the same way as main.cpp (open this file and run the build task)
+//
+//   pipeline_bench [--seed N] [--threads N] [--radius R] [--origin CX CZ] [--lod L] [--flat] [--trace FILE]
+//
+// the chunk set is the (2R+1)^2 square of chunks centred on chunk (CX, CZ), meshed at level L.
+// --flat meshes without ambient occlusion, --trace writes the run as a Chrome trace
+
+#include <algorithm>
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "include/Chunk.hpp"
+#include "include/LightPropagator.hpp"
+#include "include/FastNoiseLite.h"
+#include "include/Trace.hpp"
+#include <scripts/Loader.h>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double msSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    struct BenchConfig
+    {
+        int seed = WorldSettings::seed;
+        unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+        int radius = 8;
+        int originX = 0, originZ = 0;
+        int lod = 0;
+        bool occlusion = true;
+        std::string tracePath;
+    };
+
+    bool parseArgs(int argc, char **argv, BenchConfig &config)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            const bool hasValue = i + 1 < argc;
+            if (!std::strcmp(argv[i], "--seed") && hasValue)
+                config.seed = std::atoi(argv[++i]);
+            else if (!std::strcmp(argv[i], "--threads") && hasValue)
+                config.threads = unsigned(std::max(1, std::atoi(argv[++i])));
+            else if (!std::strcmp(argv[i], "--radius") && hasValue)
+                config.radius = std::max(0, std::atoi(argv[++i]));
+            else if (!std::strcmp(argv[i], "--origin") && i + 2 < argc)
+            {
+                config.originX = std::atoi(argv[++i]);
+                config.originZ = std::atoi(argv[++i]);
+            }
+            else if (!std::strcmp(argv[i], "--lod") && hasValue)
+                config.lod = std::clamp(std::atoi(argv[++i]), 0, WorldSettings::LOD_COUNT - 1);
+            else if (!std::strcmp(argv[i], "--flat"))
+                config.occlusion = false;
+            else if (!std::strcmp(argv[i], "--trace") && hasValue)
+                config.tracePath = argv[++i];
+            else
+            {
+                std::cout << "unknown argument " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // body(0..count-1) spread over the threads, each thread takes the next index when it is free
+    void runOnThreads(unsigned threads, size_t count, const std::function<void(size_t)> &body)
+    {
+        std::atomic<size_t> next{0};
+        auto drain = [&]
+        {
+            for (size_t i = next++; i < count; i = next++)
+            {
+                body(i);
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; t++)
+        {
+            pool.emplace_back([&]
+                              {
+                Trace::setThreadName("bench worker");
+                drain(); });
+        }
+        drain();
+        for (std::thread &thread : pool)
+        {
+            thread.join();
+        }
+    }
+
+    struct Percentiles
+    {
+        double p50 = 0.0, p99 = 0.0, max = 0.0;
+    };
+
+    Percentiles percentiles(std::vector<double> samples)
+    {
+        if (samples.empty())
+            return {};
+        std::sort(samples.begin(), samples.end());
+        auto at = [&](double q)
+        { return samples[std::min(samples.size() - 1, size_t(q * samples.size()))]; };
+        return {at(0.5), at(0.99), samples.back()};
+    }
+
+    void printStage(const char *name, const std::vector<double> &ms)
+    {
+        Percentiles p = percentiles(ms);
+        double total = 0.0;
+        for (double m : ms)
+            total += m;
+        std::cout << name << ": p50 " << p.p50 << "ms, p99 " << p.p99 << "ms, max " << p.max << "ms, "
+                  << total << "ms summed over threads" << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    BenchConfig config;
+    if (!parseArgs(argc, argv, config))
+        return 1;
+
+    FastNoiseLite noise;
+    Chunk::setupNoise(noise, config.seed);
+    Trace::setThreadName("bench main");
+    Trace::setEnabled(!config.tracePath.empty());
+
+    const int side = 2 * config.radius + 1;
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    for (int z = 0; z < side; z++)
+        for (int x = 0; x < side; x++)
+        {
+            chunks.push_back(std::make_unique<Chunk>(config.originX + x - config.radius, config.originZ + z - config.radius, noise));
+            chunks.back()->lod = config.lod;
+        }
+    std::cout << "pipeline: " << chunks.size() << " chunks (" << side << "x" << side << " around " << config.originX << ","
+              << config.originZ << "), seed " << config.seed << ", " << config.threads << " threads, lod " << config.lod
+              << (config.occlusion ? "" : ", flat") << std::endl;
+
+    // every chunk's own light needs only its own blocks, meshing needs the neighbours' blocks and
+    // light, so generation and lighting finish everywhere before any meshing starts
+    std::vector<double> generateMs(chunks.size()), lightMs(chunks.size()), meshMs(chunks.size());
+    auto start = Clock::now();
+    runOnThreads(config.threads, chunks.size(), [&](size_t i)
+                 {
+        Chunk &chunk = *chunks[i];
+        auto stageStart = Clock::now();
+        chunk.generate();
+        generateMs[i] = msSince(stageStart);
+        stageStart = Clock::now();
+        LightPropagator::lightChunk(chunk);
+        chunk.generated = true;
+        lightMs[i] = msSince(stageStart); });
+    const double generateWallMs = msSince(start);
+
+    auto at = [&](int x, int z) -> const Chunk *
+    {
+        return x < 0 || x >= side || z < 0 || z >= side ? nullptr : chunks[size_t(x + side * z)].get();
+    };
+    auto meshStart = Clock::now();
+    runOnThreads(config.threads, chunks.size(), [&](size_t i)
+                 {
+        const int x = int(i) % side, z = int(i) / side;
+        std::array<const Chunk *, 9> around{};
+        for (int dz = -1; dz <= 1; dz++)
+            for (int dx = -1; dx <= 1; dx++)
+                around[(dx + 1) + 3 * (dz + 1)] = at(x + dx, z + dz);
+        auto stageStart = Clock::now();
+        chunks[i]->buildMesh(around, config.occlusion);
+        meshMs[i] = msSince(stageStart); });
+    const double meshWallMs = msSince(meshStart);
+    const double totalMs = msSince(start);
+
+    size_t quads = 0, bytes = 0, emptyMeshes = 0;
+    for (const auto &chunk : chunks)
+    {
+        quads += chunk->meshVertices().size() / 4;
+        bytes += chunk->meshVertices().size() * sizeof(Vertex) + chunk->meshIndices().size() * sizeof(uint32_t);
+        emptyMeshes += chunk->meshIndices().empty();
+    }
+
+    printStage("generate", generateMs);
+    printStage("light", lightMs);
+    printStage("mesh", meshMs);
+    const double n = double(chunks.size());
+    std::cout << "throughput: " << n / (totalMs / 1000.0) << " chunks/s end to end (" << totalMs << "ms), "
+              << n / (generateWallMs / 1000.0) << " chunks/s generate+light, " << n / (meshWallMs / 1000.0)
+              << " chunks/s mesh" << std::endl;
+    std::cout << "meshes: " << quads / n << " quads/chunk, " << bytes / n / 1024.0 << " KiB/mesh (vertices "
+              << sizeof(Vertex) << " bytes, 4 per quad, 6 indices per quad), " << emptyMeshes << " empty" << std::endl;
+
+    if (!config.tracePath.empty())
+    {
+        Trace::setEnabled(false);
+        std::cout << (Trace::writeChromeJson(config.tracePath) ? "wrote " : "couldn't write ") << config.tracePath << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,308 @@
+// streaming benchmark: flies the camera along a recorded or hand-written path (see CameraPath.hpp)
+// and times every frame of the real render loop. build it the same way as main.cpp (open this file
+// and run the build task) and run it from the repo root so the shaders and textures are found
+//
+//   replay PATH [--step MS | --uncapped] [--budget MS] [--settle S] [--visible] [--csv FILE] [--no-prefetch]
+//               [--upload-thread]
+//
+// --step advances the path by a fixed MS per frame however long the frame took (the default, 16.667),
+// so every run asks the world for the same positions and the run is as long as the machine makes it.
+// --uncapped runs frames back to back and puts the camera wherever the wall clock says, like the game
+// does. a frame over --budget MS (16.667) counts as dropped. once the path ends the camera holds still
+// for up to --settle S (30) until everything has loaded. the window stays hidden unless --visible;
+// the world uploads meshes so it still needs a GL context, with Mesa LIBGL_ALWAYS_SOFTWARE=1 gives a
+// software one on a machine without a GPU. --no-prefetch turns off generating chunks ahead of the camera.
+// --upload-thread uploads meshes from a thread with a second, shared context instead of the render thread;
+// run the same path with and without it and compare the stddev and p99 lines
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "include/shader_m.h"
+#include "include/World.hpp"
+#include "include/CameraPath.hpp"
+#include "include/Metrics.hpp"
+#include <scripts/Loader.h>
+
+#include "libs/glad/glad.h"
+#include "libs/glfw/glfw3.h"
+#include <libs/glm/glm.hpp>
+#include <libs/glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double msSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    struct ReplayConfig
+    {
+        std::string pathFile;
+        double stepMs = 1000.0 / 60.0;
+        bool uncapped = false;
+        double budgetMs = 1000.0 / 60.0;
+        double settleSeconds = 30.0;
+        bool visible = false;
+        bool prefetch = true;
+        bool uploadThread = false;
+        std::string csvPath;
+    };
+
+    bool parseArgs(int argc, char **argv, ReplayConfig &config)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            const bool hasValue = i + 1 < argc;
+            if (!std::strcmp(argv[i], "--step") && hasValue)
+                config.stepMs = std::max(0.1, std::atof(argv[++i]));
+            else if (!std::strcmp(argv[i], "--uncapped"))
+                config.uncapped = true;
+            else if (!std::strcmp(argv[i], "--budget") && hasValue)
+                config.budgetMs = std::max(0.1, std::atof(argv[++i]));
+            else if (!std::strcmp(argv[i], "--settle") && hasValue)
+                config.settleSeconds = std::max(0.0, std::atof(argv[++i]));
+            else if (!std::strcmp(argv[i], "--visible"))
+                config.visible = true;
+            else if (!std::strcmp(argv[i], "--no-prefetch"))
+                config.prefetch = false;
+            else if (!std::strcmp(argv[i], "--upload-thread"))
+                config.uploadThread = true;
+            else if (!std::strcmp(argv[i], "--csv") && hasValue)
+                config.csvPath = argv[++i];
+            else if (argv[i][0] != '-' && config.pathFile.empty())
+                config.pathFile = argv[i];
+            else
+            {
+                std::cout << "unknown argument " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        if (config.pathFile.empty())
+        {
+            std::cout << "usage: replay PATH [--step MS | --uncapped] [--budget MS] [--settle S] [--visible] [--csv FILE] [--no-prefetch]"
+                         " [--upload-thread]" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // high water mark of the resident set, in MiB
+    double peakMemoryMiB()
+    {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return double(usage.ru_maxrss) / (1024.0 * 1024.0); // bytes on macOS
+#else
+        return double(usage.ru_maxrss) / 1024.0; // KiB on Linux
+#endif
+    }
+
+    double percentile(std::vector<double> samples, double q)
+    {
+        if (samples.empty())
+            return 0.0;
+        std::sort(samples.begin(), samples.end());
+        return samples[std::min(samples.size() - 1, size_t(q * samples.size()))];
+    }
+
+    struct Frame
+    {
+        double pathTime;
+        double ms;
+        size_t pending;
+    };
+}
+
+int main(int argc, char **argv)
+{
+    ReplayConfig config;
+    if (!parseArgs(argc, argv, config))
+        return 1;
+
+    CameraPath path;
+    std::string error;
+    if (!path.load(config.pathFile, error))
+    {
+        std::cout << error << std::endl;
+        return 1;
+    }
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, config.visible ? GLFW_TRUE : GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    GLFWwindow *window = glfwCreateWindow(WorldSettings::SCR_WIDTH, WorldSettings::SCR_HEIGHT, "replay", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *uploadWindow = config.uploadThread ? glfwCreateWindow(1, 1, "uploads", NULL, window) : NULL;
+    if (config.uploadThread && uploadWindow == NULL)
+    {
+        std::cout << "Failed to create the upload thread's window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+    // no vsync, the frame times are the work and nothing else
+    glfwSwapInterval(0);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+
+    Shader blockShader(Loader::getPath("shaders/block.vs"), Loader::getPath("shaders/block.fs"));
+    const double memoryBefore = peakMemoryMiB();
+
+    std::vector<Frame> frames;
+    double firstLoadedMs = -1.0, settleMs = -1.0;
+    {
+        World world;
+        world.setPrefetching(config.prefetch);
+        if (config.uploadThread)
+            world.startUploadThread([uploadWindow](bool bind) { glfwMakeContextCurrent(bind ? uploadWindow : NULL); });
+        const float aspect = (float)WorldSettings::SCR_WIDTH / (float)WorldSettings::SCR_HEIGHT;
+        const glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, world.chunkViewDistance());
+        const glm::mat4 farProjection = glm::perspective(glm::radians(45.0f), aspect, 8.0f, FarTerrain::VIEW_DISTANCE * 1.5f);
+
+        std::cout << "replay: " << config.pathFile << ", " << path.size() << " keys over " << path.duration() << "s, "
+                  << (config.uncapped ? std::string("uncapped") : std::to_string(config.stepMs) + "ms steps") << std::endl;
+
+        const auto start = Clock::now();
+        Clock::time_point pathEnd;
+        bool pathDone = false;
+        double pathTime = 0.0;
+        while (!glfwWindowShouldClose(window))
+        {
+            const auto frameStart = Clock::now();
+            const CameraKey key = path.sample(pathTime);
+            const glm::mat4 view = glm::lookAt(key.position, key.position + key.front(), glm::vec3(0.0f, 1.0f, 0.0f));
+            const glm::mat4 viewProjection = projection * view;
+            const glm::mat4 t = glm::transpose(viewProjection);
+            const std::vector<glm::vec4> frustumPlanes = {t[3] + t[0], t[3] - t[0], t[3] + t[1], t[3] - t[1], t[3] + t[2], t[3] - t[2]};
+
+            // the same frame main draws
+            // the far terrain leaves its own program bound
+            blockShader.use();
+            blockShader.setMat4("projection", projection);
+            blockShader.setMat4("view", view);
+            glClearColor(0.47f, 0.75f, 0.88f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            world.drawFarTerrain(farProjection * view, key.position);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            world.manageChunks(key.position, blockShader, frustumPlanes, viewProjection);
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+
+            const size_t pending = world.pendingChunks();
+            frames.push_back(Frame{pathTime, msSince(frameStart), pending});
+            // the first frame only queues the starting square, it can't be loaded yet
+            if (firstLoadedMs < 0.0 && frames.size() > 1 && pending == 0)
+                firstLoadedMs = msSince(start);
+
+            if (pathDone)
+            {
+                if (pending == 0)
+                {
+                    settleMs = msSince(pathEnd);
+                    break;
+                }
+                if (msSince(pathEnd) > config.settleSeconds * 1000.0)
+                    break;
+            }
+            else if (pathTime >= path.duration())
+            {
+                pathDone = true;
+                pathEnd = Clock::now();
+            }
+            pathTime = config.uncapped ? msSince(start) / 1000.0 : pathTime + config.stepMs / 1000.0;
+        }
+
+        const WorldStats &stats = world.getStats();
+        if (config.prefetch)
+        {
+            const Metrics::Snapshot &snapshot = Metrics::sample();
+            auto total = [&](const char *name)
+            {
+                const Metrics::Row *row = Metrics::find(snapshot, name);
+                return row ? row->total : 0.0;
+            };
+            const double hits = total("prefetch hits"), late = total("prefetch late"), wasted = total("prefetch wasted");
+            std::cout << "prefetch: " << total("prefetch queued") << " queued, " << hits << " hits, " << late << " late, "
+                      << wasted << " wasted, " << total("prefetch cancelled") << " cancelled before generating ("
+                      << (hits + late + wasted > 0 ? 100.0 * hits / (hits + late + wasted) : 0.0) << "% hit rate)" << std::endl;
+        }
+        std::cout << "stream: " << stats.chunksLoaded << " chunks loaded, " << stats.chunksUnloaded << " unloaded, "
+                  << stats.streamUpdates << " updates in " << stats.streamMs << "ms" << std::endl;
+    }
+
+    std::vector<double> ms;
+    size_t dropped = 0, busy = 0;
+    double total = 0.0;
+    for (const Frame &frame : frames)
+    {
+        ms.push_back(frame.ms);
+        total += frame.ms;
+        dropped += frame.ms > config.budgetMs;
+        busy += frame.pending > 0;
+    }
+    std::cout << "frames: " << frames.size() << " in " << total / 1000.0 << "s, p50 " << percentile(ms, 0.5) << "ms, p99 "
+              << percentile(ms, 0.99) << "ms, max " << percentile(ms, 1.0) << "ms" << std::endl;
+    // how much the frame time wobbles, what moving the uploads off the render thread should bring down
+    const double mean = frames.empty() ? 0.0 : total / double(frames.size());
+    double squares = 0.0;
+    for (double frameMs : ms)
+        squares += (frameMs - mean) * (frameMs - mean);
+    const double variance = frames.size() > 1 ? squares / double(frames.size() - 1) : 0.0;
+    std::cout << "variance: mean " << mean << "ms, stddev " << std::sqrt(variance) << "ms, " << variance << "ms^2 ("
+              << (config.uploadThread ? "upload thread" : "uploads on the render thread") << ")" << std::endl;
+    std::cout << "dropped: " << dropped << " frames over " << config.budgetMs << "ms ("
+              << (frames.empty() ? 0.0 : 100.0 * double(dropped) / double(frames.size())) << "%)" << std::endl;
+    std::cout << "loading: ";
+    if (firstLoadedMs >= 0.0)
+        std::cout << "first fully loaded after " << firstLoadedMs << "ms, ";
+    else
+        std::cout << "never fully loaded, ";
+    std::cout << busy << " frames with chunks pending, ";
+    if (settleMs >= 0.0)
+        std::cout << "settled " << settleMs << "ms after the path ended" << std::endl;
+    else
+        std::cout << "still loading " << config.settleSeconds << "s after the path ended" << std::endl;
+    std::cout << "memory: peak " << peakMemoryMiB() << " MiB resident (" << memoryBefore << " MiB before the world)" << std::endl;
+
+    if (!config.csvPath.empty())
+    {
+        std::ofstream csv(config.csvPath);
+        csv << "frame,path_time,ms,pending\n";
+        for (size_t i = 0; i < frames.size(); i++)
+            csv << i << ',' << frames[i].pathTime << ',' << frames[i].ms << ',' << frames[i].pending << '\n';
+        std::cout << (csv ? "wrote " : "couldn't write ") << config.csvPath << std::endl;
+    }
+
+    glfwTerminate();
+    return 0;
+}